@@ -1,6 +1,10 @@
 #ifndef VECTOR_3F_H
 #define VECTOR_3F_H
 
+#include <cmath>
+
+#include "vecmath_simd.h"
+
 class Vector2f;
 
 class Vector3f
@@ -12,42 +16,42 @@ public:
 	static const Vector3f RIGHT;
 	static const Vector3f FORWARD;
 
-    explicit Vector3f( float f = 0.f );
-    Vector3f( float x, float y, float z );
+    explicit constexpr Vector3f( float f = 0.f );
+    constexpr Vector3f( float x, float y, float z );
 
 	Vector3f( const Vector2f& xy, float z );
 	Vector3f( float x, const Vector2f& yz );
 
 	// copy constructors
-    Vector3f( const Vector3f& rv );
+    Vector3f( const Vector3f& rv ) = default;
 
 	// assignment operators
-    Vector3f& operator = ( const Vector3f& rv );
+    Vector3f& operator = ( const Vector3f& rv ) = default;
 
 	// no destructor necessary
 
 	// returns the ith element
-    const float& operator [] ( int i ) const;
+    constexpr const float& operator [] ( int i ) const;
     float& operator [] ( int i );
 
     float& x();
 	float& y();
 	float& z();
 
-	float x() const;
-	float y() const;
-	float z() const;
+	constexpr float x() const;
+	constexpr float y() const;
+	constexpr float z() const;
 
 	Vector2f xy() const;
 	Vector2f xz() const;
 	Vector2f yz() const;
 
-	Vector3f xyz() const;
-	Vector3f yzx() const;
-	Vector3f zxy() const;
+	constexpr Vector3f xyz() const;
+	constexpr Vector3f yzx() const;
+	constexpr Vector3f zxy() const;
 
 	float abs() const;
-    float absSquared() const;
+    constexpr float absSquared() const;
 
 	void normalize();
 	Vector3f normalized() const;
@@ -58,48 +62,318 @@ public:
 
 	// ---- Utility ----
     operator const float* () const; // automatic type conversion for OpenGL
-    operator float* (); // automatic type conversion for OpenGL 
-	void print() const;	
+    operator float* (); // automatic type conversion for OpenGL
+	void print() const;
 
 	Vector3f& operator += ( const Vector3f& v );
 	Vector3f& operator -= ( const Vector3f& v );
   Vector3f& operator *= ( float f );
   Vector3f& operator /= (float f );
 
-  static float dot( const Vector3f& v0, const Vector3f& v1 );
-	static Vector3f cross( const Vector3f& v0, const Vector3f& v1 );
-    
+  static constexpr float dot( const Vector3f& v0, const Vector3f& v1 );
+	static constexpr Vector3f cross( const Vector3f& v0, const Vector3f& v1 );
+
     // computes the linear interpolation between v0 and v1 by alpha \in [0,1]
 	// returns v0 * ( 1 - alpha ) * v1 * alpha
-	static Vector3f lerp( const Vector3f& v0, const Vector3f& v1, float alpha );
+	static VECMATH_CONSTEXPR Vector3f lerp( const Vector3f& v0, const Vector3f& v1, float alpha );
 
 	// computes the cubic catmull-rom interpolation between p0, p1, p2, p3
     // by t \in [0,1].  Guarantees that at t = 0, the result is p0 and
     // at p1, the result is p2.
 	static Vector3f cubicInterpolate( const Vector3f& p0, const Vector3f& p1, const Vector3f& p2, const Vector3f& p3, float t );
 
+#ifdef VECMATH_SIMD_STORAGE
+	// the register form, padding in the last lane
+	explicit Vector3f( vecmath::float4 v );
+	vecmath::float4 simd() const;
+#endif
+
 private:
 
+#ifdef VECMATH_SIMD_STORAGE
+	alignas( 16 ) float m_elements[ 4 ]; // x, y, z, padding
+#else
 	float m_elements[ 3 ];
+#endif
 
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline constexpr Vector3f::Vector3f( float f ) :
+	m_elements{ f, f, f }
+{
+}
+
+inline constexpr Vector3f::Vector3f( float x, float y, float z ) :
+	m_elements{ x, y, z }
+{
+}
+
+#ifdef VECMATH_SIMD_STORAGE
+inline Vector3f::Vector3f( vecmath::float4 v )
+{
+	vecmath::store4( m_elements, v );
+}
+
+inline vecmath::float4 Vector3f::simd() const
+{
+	return vecmath::load4( m_elements );
+}
+#endif
+
+inline constexpr const float& Vector3f::operator [] ( int i ) const
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::operator [] ( int i )
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::x()
+{
+	return m_elements[ 0 ];
+}
+
+inline float& Vector3f::y()
+{
+	return m_elements[ 1 ];
+}
+
+inline float& Vector3f::z()
+{
+	return m_elements[ 2 ];
+}
+
+inline constexpr float Vector3f::x() const
+{
+	return m_elements[ 0 ];
+}
+
+inline constexpr float Vector3f::y() const
+{
+	return m_elements[ 1 ];
+}
+
+inline constexpr float Vector3f::z() const
+{
+	return m_elements[ 2 ];
+}
+
+inline constexpr Vector3f Vector3f::xyz() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+inline constexpr Vector3f Vector3f::yzx() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] );
+}
+
+inline constexpr Vector3f Vector3f::zxy() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline float Vector3f::abs() const
+{
+	return std::sqrt( m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ] );
+}
+
+inline constexpr float Vector3f::absSquared() const
+{
+	return m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ];
+}
+
+inline void Vector3f::normalize()
+{
+	float norm = abs();
+	m_elements[ 0 ] /= norm;
+	m_elements[ 1 ] /= norm;
+	m_elements[ 2 ] /= norm;
+}
+
+inline Vector3f Vector3f::normalized() const
+{
+	float norm = abs();
+	return Vector3f( m_elements[ 0 ] / norm, m_elements[ 1 ] / norm, m_elements[ 2 ] / norm );
+}
+
+inline void Vector3f::negate()
+{
+	m_elements[ 0 ] = -m_elements[ 0 ];
+	m_elements[ 1 ] = -m_elements[ 1 ];
+	m_elements[ 2 ] = -m_elements[ 2 ];
+}
+
+inline Vector3f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline Vector3f::operator float* ()
+{
+	return m_elements;
+}
+
+inline Vector3f& Vector3f::operator += ( const Vector3f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	vecmath::store4( m_elements, vecmath::add4( simd(), v.simd() ) );
+#else
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	m_elements[ 2 ] += v.m_elements[ 2 ];
+#endif
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator -= ( const Vector3f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	vecmath::store4( m_elements, vecmath::sub4( simd(), v.simd() ) );
+#else
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	m_elements[ 2 ] -= v.m_elements[ 2 ];
+#endif
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator *= ( float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	vecmath::store4( m_elements, vecmath::mul4( simd(), vecmath::splat4( f ) ) );
+#else
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	m_elements[ 2 ] *= f;
+#endif
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator /= ( float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	vecmath::store4( m_elements, vecmath::div4( simd(), vecmath::splat4( f ) ) );
+#else
+	m_elements[ 0 ] /= f;
+	m_elements[ 1 ] /= f;
+	m_elements[ 2 ] /= f;
+#endif
+	return *this;
+}
+
+// static
+inline constexpr float Vector3f::dot( const Vector3f& v0, const Vector3f& v1 )
+{
+	return v0[ 0 ] * v1[ 0 ] + v0[ 1 ] * v1[ 1 ] + v0[ 2 ] * v1[ 2 ];
+}
+
+// static
+inline constexpr Vector3f Vector3f::cross( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f
+		(
+			v0.y() * v1.z() - v0.z() * v1.y(),
+			v0.z() * v1.x() - v0.x() * v1.z(),
+			v0.x() * v1.y() - v0.y() * v1.x()
+		);
+}
+
 // component-wise operators
-Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 );
+inline VECMATH_CONSTEXPR Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::add4( v0.simd(), v1.simd() ) );
+#else
+	return Vector3f( v0[ 0 ] + v1[ 0 ], v0[ 1 ] + v1[ 1 ], v0[ 2 ] + v1[ 2 ] );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::sub4( v0.simd(), v1.simd() ) );
+#else
+	return Vector3f( v0[ 0 ] - v1[ 0 ], v0[ 1 ] - v1[ 1 ], v0[ 2 ] - v1[ 2 ] );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::mul4( v0.simd(), v1.simd() ) );
+#else
+	return Vector3f( v0[ 0 ] * v1[ 0 ], v0[ 1 ] * v1[ 1 ], v0[ 2 ] * v1[ 2 ] );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::div4( v0.simd(), v1.simd() ) );
+#else
+	return Vector3f( v0[ 0 ] / v1[ 0 ], v0[ 1 ] / v1[ 1 ], v0[ 2 ] / v1[ 2 ] );
+#endif
+}
 
 // unary negation
-Vector3f operator - ( const Vector3f& v );
+inline VECMATH_CONSTEXPR Vector3f operator - ( const Vector3f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::neg4( v.simd() ) );
+#else
+	return Vector3f( -v[ 0 ], -v[ 1 ], -v[ 2 ] );
+#endif
+}
 
 // multiply and divide by scalar
-Vector3f operator * ( float f, const Vector3f& v );
-Vector3f operator * ( const Vector3f& v, float f );
-Vector3f operator / ( const Vector3f& v, float f );
+inline VECMATH_CONSTEXPR Vector3f operator * ( float f, const Vector3f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::mul4( v.simd(), vecmath::splat4( f ) ) );
+#else
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+#endif
+}
 
+inline VECMATH_CONSTEXPR Vector3f operator * ( const Vector3f& v, float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::mul4( v.simd(), vecmath::splat4( f ) ) );
+#else
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+#endif
+}
 
-bool operator == ( const Vector3f& v0, const Vector3f& v1 );
-bool operator != ( const Vector3f& v0, const Vector3f& v1 );
+inline VECMATH_CONSTEXPR Vector3f operator / ( const Vector3f& v, float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector3f( vecmath::div4( v.simd(), vecmath::splat4( f ) ) );
+#else
+	return Vector3f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f );
+#endif
+}
+
+inline constexpr bool operator == ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() );
+}
+
+inline constexpr bool operator != ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return !( v0 == v1 );
+}
+
+// static
+inline VECMATH_CONSTEXPR Vector3f Vector3f::lerp( const Vector3f& v0, const Vector3f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
 
 #endif // VECTOR_3F_H
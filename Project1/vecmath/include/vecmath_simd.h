@@ -0,0 +1,73 @@
+#ifndef VECMATH_SIMD_H
+#define VECMATH_SIMD_H
+
+// Optional SIMD storage for Vector3f, Vector4f and Matrix4f.
+//
+// By default vecmath is scalar code whose hot functions are all inline and
+// whose constructors and accessors are constexpr. Defining VECMATH_SIMD on
+// an SSE or AArch64 NEON target stores Vector3f and Vector4f as one aligned
+// 16-byte register (a Vector3f grows from 12 to 16 bytes) and Matrix4f as
+// four aligned columns, and does component-wise arithmetic and matrix
+// products with vector instructions. It changes the class layouts, so it
+// must be defined for every translation unit that includes vecmath.
+//
+// Both forms do the same single precision operations in the same order and
+// give identical results.
+
+#if defined( VECMATH_SIMD ) && ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) )
+#include <xmmintrin.h>
+#define VECMATH_SSE
+#elif defined( VECMATH_SIMD ) && defined( __ARM_NEON ) && defined( __aarch64__ )
+#include <arm_neon.h>
+#define VECMATH_NEON
+#endif
+
+#if defined( VECMATH_SSE ) || defined( VECMATH_NEON )
+
+#define VECMATH_SIMD_STORAGE
+
+// intrinsics are not constant expressions
+#define VECMATH_CONSTEXPR
+
+namespace vecmath
+{
+
+#ifdef VECMATH_SSE
+
+typedef __m128 float4;
+
+inline float4 load4( const float* p ) { return _mm_load_ps( p ); }
+inline void store4( float* p, float4 v ) { _mm_store_ps( p, v ); }
+inline float4 splat4( float f ) { return _mm_set1_ps( f ); }
+
+inline float4 add4( float4 a, float4 b ) { return _mm_add_ps( a, b ); }
+inline float4 sub4( float4 a, float4 b ) { return _mm_sub_ps( a, b ); }
+inline float4 mul4( float4 a, float4 b ) { return _mm_mul_ps( a, b ); }
+inline float4 div4( float4 a, float4 b ) { return _mm_div_ps( a, b ); }
+inline float4 neg4( float4 a ) { return _mm_xor_ps( a, _mm_set1_ps( -0.f ) ); }
+
+#else
+
+typedef float32x4_t float4;
+
+inline float4 load4( const float* p ) { return vld1q_f32( p ); }
+inline void store4( float* p, float4 v ) { vst1q_f32( p, v ); }
+inline float4 splat4( float f ) { return vdupq_n_f32( f ); }
+
+inline float4 add4( float4 a, float4 b ) { return vaddq_f32( a, b ); }
+inline float4 sub4( float4 a, float4 b ) { return vsubq_f32( a, b ); }
+inline float4 mul4( float4 a, float4 b ) { return vmulq_f32( a, b ); }
+inline float4 div4( float4 a, float4 b ) { return vdivq_f32( a, b ); }
+inline float4 neg4( float4 a ) { return vnegq_f32( a ); }
+
+#endif
+
+}
+
+#else
+
+#define VECMATH_CONSTEXPR constexpr
+
+#endif
+
+#endif // VECMATH_SIMD_H
@@ -0,0 +1,56 @@
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <vecmath.h>
+
+// The top three rows of a 4x4 matrix whose last row is (0, 0, 0, 1): all
+// that Transform needs of its matrices, applied without the fourth row or
+// the homogeneous divide.
+class Affine
+{
+  public:
+    Affine() : Affine(Matrix4f::identity()) { }
+
+    explicit Affine(const Matrix4f &m) {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                _m[i][j] = m(i, j);
+            }
+        }
+    }
+
+    Matrix4f toMatrix4f() const {
+        Matrix4f m = Matrix4f::identity();
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                m(i, j) = _m[i][j];
+            }
+        }
+        return m;
+    }
+
+    Vector3f point(const Vector3f &p) const {
+        return Vector3f(_m[0][0] * p[0] + _m[0][1] * p[1] + _m[0][2] * p[2] + _m[0][3],
+                        _m[1][0] * p[0] + _m[1][1] * p[1] + _m[1][2] * p[2] + _m[1][3],
+                        _m[2][0] * p[0] + _m[2][1] * p[1] + _m[2][2] * p[2] + _m[2][3]);
+    }
+
+    Vector3f vector(const Vector3f &v) const {
+        return Vector3f(_m[0][0] * v[0] + _m[0][1] * v[1] + _m[0][2] * v[2],
+                        _m[1][0] * v[0] + _m[1][1] * v[1] + _m[1][2] * v[2],
+                        _m[2][0] * v[0] + _m[2][1] * v[1] + _m[2][2] * v[2]);
+    }
+
+    // v through the transposed linear part: on the inverse matrix, this
+    // carries normals from object to world space (unnormalized)
+    Vector3f transposedVector(const Vector3f &v) const {
+        return Vector3f(_m[0][0] * v[0] + _m[1][0] * v[1] + _m[2][0] * v[2],
+                        _m[0][1] * v[0] + _m[1][1] * v[1] + _m[2][1] * v[2],
+                        _m[0][2] * v[0] + _m[1][2] * v[1] + _m[2][2] * v[2]);
+    }
+
+  private:
+    float _m[3][4];
+};
+
+#endif // AFFINE_H
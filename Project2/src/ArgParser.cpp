@@ -26,6 +26,13 @@ ArgParser::ArgParser(int argc, const char *argv[])
             width = atoi(argv[i]);
             i++; assert (i < argc); 
             height = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-format")) {
+            i++; assert (i < argc); 
+            format = argv[i];
+            if (format != "png" && format != "pfm" && format != "exr") {
+                printf ("Output format must be png, pfm or exr, got '%s'\n", argv[i]);
+                exit(1);
+            }
         } 
 
         // rendering options
@@ -41,6 +48,11 @@ ArgParser::ArgParser(int argc, const char *argv[])
             bounces = atoi(argv[i]);
         } else if (!strcmp(argv[i], "-shadows")) {
             shadows = true;
+        } else if (!strcmp(argv[i], "-env_lod")) {
+            i++; assert (i < argc); 
+            env_lod = (float)atof(argv[i]);
+        } else if (!strcmp(argv[i], "-stats")) {
+            stats = 1;
         }
 
         // supersampling
@@ -48,13 +60,92 @@ ArgParser::ArgParser(int argc, const char *argv[])
             jitter = true;
         } else if(strcmp(argv[i], "-filter") == 0) {
             filter = true;
-        } 
+        } else if (!strcmp(argv[i], "-samples")) {
+            i++; assert (i < argc); 
+            samples = atoi(argv[i]);
+            if (samples < 1) {
+                printf ("Samples must be at least 1, got '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-sampler")) {
+            i++; assert (i < argc); 
+            sampler = argv[i];
+        } else if (!strcmp(argv[i], "-pixel_filter")) {
+            i++; assert (i < argc); 
+            pixel_filter = argv[i];
+            filter = true;
+        } else if (!strcmp(argv[i], "-filter_radius")) {
+            i++; assert (i < argc); 
+            filter_radius = (float)atof(argv[i]);
+            // SplatBuffer relies on the limit
+            if (filter_radius < 0 || filter_radius > 8) {
+                printf ("Filter radius must be between 0 and 8 pixels, got '%s'\n", argv[i]);
+                exit(1);
+            }
+            filter = true;
+        } else if (!strcmp(argv[i], "-adaptive")) {
+            i++; assert (i < argc); 
+            max_samples = atoi(argv[i]);
+            i++; assert (i < argc); 
+            threshold = (float)atof(argv[i]);
+            if (max_samples < 1 || threshold < 0) {
+                printf ("Adaptive sampling needs max_samples >= 1 and threshold >= 0\n");
+                exit(1);
+            }
+            // samples of a pixel must differ to tell anything apart
+            adaptive = true;
+            jitter = true;
+        }
+
+        // progressive rendering
+        else if (!strcmp(argv[i], "-progressive")) {
+            progressive = true;
+        } else if (!strcmp(argv[i], "-time_budget")) {
+            i++; assert (i < argc); 
+            time_budget = (float)atof(argv[i]);
+            progressive = true;
+        } else if (!strcmp(argv[i], "-checkpoint")) {
+            i++; assert (i < argc); 
+            checkpoint = (float)atof(argv[i]);
+            progressive = true;
+        } else if (!strcmp(argv[i], "-stream")) {
+            stream = true;
+        } else if (!strcmp(argv[i], "-half_film")) {
+            half_film = true;
+        }
+
+        // parallelism
+        else if (!strcmp(argv[i], "-threads")) {
+            i++; assert (i < argc); 
+            threads = atoi(argv[i]);
+        } else if (!strcmp(argv[i], "-packet")) {
+            i++; assert (i < argc); 
+            packet = atoi(argv[i]);
+            if (packet != 0 && packet != 4 && packet != 8 && packet != 16) {
+                printf ("Packet size must be 0, 4, 8 or 16, got '%s'\n", argv[i]);
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], "-accel")) {
+            i++; assert (i < argc); 
+            accel = argv[i];
+        } else if (!strcmp(argv[i], "-no_mesh_cache")) {
+            mesh_cache = false;
+        }
         else {
             printf ("Unknown command line argument %d: '%s'\n", i, argv[i]);
             exit(1);
         }
     }
 
+    if (stream && format != "png") {
+        printf ("-stream only writes png files\n");
+        exit(1);
+    }
+    if (stream && progressive) {
+        printf ("-stream cannot be combined with progressive rendering\n");
+        exit(1);
+    }
+
     std::cout << "Args:\n";
     std::cout << "- input: " << input_file << std::endl;
     std::cout << "- output: " << output_file << std::endl;
@@ -62,10 +153,46 @@ ArgParser::ArgParser(int argc, const char *argv[])
     std::cout << "- normals_file: " << normals_file << std::endl;
     std::cout << "- width: " << width << std::endl;
     std::cout << "- height: " << height << std::endl;
+    std::cout << "- format: " << format << std::endl;
     std::cout << "- depth_min: " << depth_min << std::endl;
     std::cout << "- depth_max: " << depth_max << std::endl;
     std::cout << "- bounces: " << bounces << std::endl;
     std::cout << "- shadows: " << shadows << std::endl;
+    std::cout << "- env_lod: ";
+    if (env_lod < 0) {
+        std::cout << "auto";
+    } else {
+        std::cout << env_lod;
+    }
+    std::cout << std::endl;
+    std::cout << "- samples: " << samples << std::endl;
+    std::cout << "- sampler: " << sampler << std::endl;
+    std::cout << "- filter: " << filter;
+    if (filter) {
+        // radius 0 leaves it to the filter (see Filter::create)
+        std::cout << " (" << pixel_filter << ", radius ";
+        if (filter_radius > 0) {
+            std::cout << filter_radius;
+        } else {
+            std::cout << "default";
+        }
+        std::cout << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "- adaptive: " << adaptive;
+    if (adaptive) {
+        std::cout << " (max_samples " << max_samples << ", threshold " << threshold << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "- progressive: " << progressive << std::endl;
+    std::cout << "- time_budget: " << time_budget << std::endl;
+    std::cout << "- checkpoint: " << checkpoint << std::endl;
+    std::cout << "- stream: " << stream << std::endl;
+    std::cout << "- half_film: " << half_film << std::endl;
+    std::cout << "- threads: " << threads << std::endl;
+    std::cout << "- packet: " << packet << std::endl;
+    std::cout << "- accel: " << accel << std::endl;
+    std::cout << "- mesh_cache: " << mesh_cache << std::endl;
 }
 
 void
@@ -79,14 +206,35 @@ ArgParser::defaultValues()
     width = 100;
     height = 100;
     stats = 0;
+    format = "png";
 
     // rendering options
     depth_min = 0;
     depth_max = 1;
     bounces = 0;
     shadows = false;
+    env_lod = -1;
 
     // sampling
     jitter = false;
     filter = false;
+    samples = 16;
+    sampler = "independent";
+    pixel_filter = "tent";
+    filter_radius = 0;
+    adaptive = false;
+    max_samples = 0;
+    threshold = 0;
+
+    progressive = false;
+    time_budget = 0;
+    checkpoint = 0;
+    stream = false;
+    half_film = false;
+
+    // parallelism (0 = one worker per core)
+    threads = 0;
+    packet = 0;
+    accel = "octree";
+    mesh_cache = true;
 }
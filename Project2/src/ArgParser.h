@@ -20,15 +20,64 @@ public:
     int height;
     int stats;
 
+    // file format of the outputs: png (8-bit), pfm or exr (uncompressed
+    // float, or half with half_film, for compositing)
+    std::string format;
+
     // rendering options
     float depth_min;
     float depth_max;
     int bounces;
     bool shadows;
 
-    // supersampling
+    // cube map level of detail: < 0 picks it from the angle a pixel covers
+    float env_lod;
+
+    // supersampling: with jitter, `samples` camera rays per pixel, placed
+    // by the named Sampler; with filter, every sample is splatted into the
+    // pixels around it through the named pixel Filter of the given radius
+    // (0 for the filter's default)
     bool jitter;
     bool filter;
+    int samples;
+    std::string sampler;
+    std::string pixel_filter;
+    float filter_radius;
+
+    // adaptive sampling: keep sampling a pixel, up to max_samples camera
+    // rays, until the standard error of its color is below threshold
+    bool adaptive;
+    int max_samples;
+    float threshold;
+
+    // progressive rendering: pass after pass over the whole image, with
+    // the images written every `checkpoint` seconds and at the end, even
+    // when time_budget seconds (scene loading included) run out or
+    // SIGTERM arrives first; 0 means no limit / no checkpoints
+    bool progressive;
+    float time_budget;
+    float checkpoint;
+
+    // streaming film: render in bands of rows from the top of the image down
+    // and write every finished band to the output files, so that memory
+    // does not grow with the image size (not with progressive)
+    bool stream;
+
+    // keep the film in half floats: half the memory, but the 8-bit output
+    // can be one step off where a value sits on a quantization edge
+    bool half_film;
+
+    // parallelism
+    int threads;
+
+    // primary rays traced together: 0 (one at a time), 4, 8 or 16
+    int packet;
+
+    // default mesh acceleration structure: none, octree or bvh
+    std::string accel;
+
+    // keep loaded meshes in <file>.obj.<accel>.cache (see MeshCache)
+    bool mesh_cache;
 
 private:
     void defaultValues();
@@ -0,0 +1,81 @@
+#ifndef BOX_H
+#define BOX_H
+
+#include "Ray.h"
+#include "Vector3f.h"
+
+#include <algorithm>
+#include <limits>
+
+// Axis aligned bounding box
+struct Box
+{
+    Vector3f mn, mx;
+
+    Box() {}
+
+    Box(const Vector3f &a, const Vector3f &b) :
+        mn(a),
+        mx(b)
+    {}
+
+    Box(float mnx, float mny, float mnz,
+        float mxx, float mxy, float mxz) :
+        mn(Vector3f(mnx, mny, mnz)),
+        mx(Vector3f(mxx, mxy, mxz))
+    {}
+
+    // inverted box that any expand() call replaces
+    static Box empty() {
+        const float inf = std::numeric_limits<float>::infinity();
+        return Box(inf, inf, inf, -inf, -inf, -inf);
+    }
+
+    void expand(const Vector3f &p) {
+        for (int dim = 0; dim < 3; dim++) {
+            mn[dim] = std::min(mn[dim], p[dim]);
+            mx[dim] = std::max(mx[dim], p[dim]);
+        }
+    }
+
+    void expand(const Box &b) {
+        for (int dim = 0; dim < 3; dim++) {
+            mn[dim] = std::min(mn[dim], b.mn[dim]);
+            mx[dim] = std::max(mx[dim], b.mx[dim]);
+        }
+    }
+
+    Vector3f centroid() const {
+        return (mn + mx) * 0.5f;
+    }
+
+    // surface area, the SAH cost weight
+    float area() const {
+        Vector3f d = mx - mn;
+        if (d[0] < 0 || d[1] < 0 || d[2] < 0) {
+            return 0;
+        }
+        return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+    }
+
+    ///@brief slab test against [tmin, tmax]; tnear is the entry distance
+    bool intersect(const Ray &r, float tmin, float tmax, float &tnear) const {
+        const Vector3f &o = r.getOrigin();
+        const Vector3f &invDir = r.getInvDirection();
+        for (int dim = 0; dim < 3; dim++) {
+            // the ray's sign picks the near and far slab without a compare
+            int s = r.getSign(dim);
+            float t0 = ((s ? mx : mn)[dim] - o[dim]) * invDir[dim];
+            float t1 = ((s ? mn : mx)[dim] - o[dim]) * invDir[dim];
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+            if (tmin > tmax) {
+                return false;
+            }
+        }
+        tnear = tmin;
+        return true;
+    }
+};
+
+#endif // BOX_H
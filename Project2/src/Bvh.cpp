@@ -0,0 +1,137 @@
+#include "Bvh.h"
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cassert>
+
+void
+Bvh::build(const std::vector<Box> &bounds, int maxLeaf)
+{
+    _maxLeaf = maxLeaf;
+    _nodes.clear();
+    _indices.resize(bounds.size());
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::vector<Vector3f> centroids(bounds.size());
+    for (size_t ii = 0; ii < bounds.size(); ii++) {
+        _indices[ii] = (int)ii;
+        centroids[ii] = bounds[ii].centroid();
+    }
+
+    // a binary tree has fewer than 2n nodes
+    _nodes.reserve(2 * bounds.size());
+    buildNode(bounds, centroids, 0, (int)bounds.size(), 0);
+    _nodes.shrink_to_fit();
+}
+
+void
+Bvh::save(CacheWriter &out) const
+{
+    out.value((int32_t)_maxLeaf);
+    out.value((int32_t)num_bins);
+    out.array(_nodes);
+    out.array(_indices);
+}
+
+bool
+Bvh::load(CacheReader &in, int maxLeaf)
+{
+    int32_t leaf, bins;
+    if (!in.value(leaf) || !in.value(bins) || leaf != maxLeaf || bins != num_bins) {
+        return false;
+    }
+    _maxLeaf = maxLeaf;
+    return in.array(_nodes) && in.array(_indices);
+}
+
+int
+Bvh::buildNode(const std::vector<Box> &bounds,
+               const std::vector<Vector3f> &centroids,
+               int begin, int end, int depth)
+{
+    int index = (int)_nodes.size();
+    _nodes.push_back(BvhNode());
+
+    Box box = Box::empty(), cbox = Box::empty();
+    for (int ii = begin; ii < end; ii++) {
+        box.expand(bounds[_indices[ii]]);
+        cbox.expand(centroids[_indices[ii]]);
+    }
+    _nodes[index].box = box;
+    _nodes[index].start = begin;
+    _nodes[index].count = end - begin;
+
+    int n = end - begin;
+    if (n <= _maxLeaf || depth + 1 >= max_depth) {
+        return index;
+    }
+
+    // Bin the centroids along every axis and sweep the bin boundaries for
+    // the cheapest split: cost = N_left * A_left + N_right * A_right.
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = cbox.mn[axis], extent = cbox.mx[axis] - lo;
+        if (extent <= 0) {
+            continue;
+        }
+        float scale = num_bins / extent;
+
+        int count[num_bins] = {};
+        Box binBox[num_bins];
+        for (int b = 0; b < num_bins; b++) {
+            binBox[b] = Box::empty();
+        }
+        for (int ii = begin; ii < end; ii++) {
+            int p = _indices[ii];
+            int b = std::min(num_bins - 1, (int)((centroids[p][axis] - lo) * scale));
+            count[b]++;
+            binBox[b].expand(bounds[p]);
+        }
+
+        // rightCost[b]: cost of everything in bins [b, num_bins)
+        float rightCost[num_bins];
+        Box acc = Box::empty();
+        int accCount = 0;
+        for (int b = num_bins - 1; b > 0; b--) {
+            acc.expand(binBox[b]);
+            accCount += count[b];
+            rightCost[b] = accCount * acc.area();
+        }
+        acc = Box::empty();
+        accCount = 0;
+        for (int b = 0; b < num_bins - 1; b++) {
+            acc.expand(binBox[b]);
+            accCount += count[b];
+            float cost = accCount * acc.area() + rightCost[b + 1];
+            if (accCount > 0 && accCount < n && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    // Leaf cost is n * A; a split costs one traversal step plus the children.
+    float leafCost = n * box.area();
+    if (bestAxis < 0 || bestCost + box.area() >= leafCost) {
+        return index;
+    }
+
+    float lo = cbox.mn[bestAxis];
+    float scale = num_bins / (cbox.mx[bestAxis] - lo);
+    int *mid = std::partition(&_indices[begin], &_indices[begin] + n, [&](int p)
+    {
+        return std::min(num_bins - 1, (int)((centroids[p][bestAxis] - lo) * scale)) < bestSplit;
+    });
+    int split = (int)(mid - &_indices[0]);
+    assert(split > begin && split < end);
+
+    buildNode(bounds, centroids, begin, split, depth + 1);
+    int right = buildNode(bounds, centroids, split, end, depth + 1);
+    _nodes[index].start = right;
+    _nodes[index].count = 0;
+    return index;
+}
@@ -0,0 +1,338 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "Box.h"
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Stats.h"
+
+#include <vector>
+
+class CacheReader;
+class CacheWriter;
+
+// One BVH node, 32 bytes. Nodes are stored depth-first, so the left child of
+// an inner node immediately follows it and only the right child is linked.
+struct BvhNode
+{
+    Box box;
+    int start; // leaf: first slot in the primitive index array; inner: right child
+    int count; // leaf: number of primitives; 0 for inner nodes
+
+    bool isLeaf() const {
+        return count > 0;
+    }
+};
+
+// Bounding volume hierarchy over an arbitrary set of primitives, built with
+// the binned surface area heuristic. The tree only knows primitive bounds;
+// callers supply the primitive test when traversing.
+class Bvh
+{
+  public:
+    Bvh() {}
+
+    // Builds the tree over the given primitive bounds. A leaf is made once a
+    // node holds at most maxLeaf primitives or splitting no longer pays off.
+    void build(const std::vector<Box> &bounds, int maxLeaf = 4);
+
+    // The built tree in a mesh cache; load() fails if the cache was built
+    // with another maxLeaf.
+    void save(CacheWriter &out) const;
+    bool load(CacheReader &in, int maxLeaf = 4);
+
+    bool empty() const {
+        return _nodes.empty();
+    }
+
+    const Box &bounds() const {
+        return _nodes[0].box;
+    }
+
+    const std::vector<BvhNode> &nodes() const {
+        return _nodes;
+    }
+
+    // leaf slot -> primitive index; a leaf covers slots [start, start + count)
+    const std::vector<int> &indices() const {
+        return _indices;
+    }
+
+    // bytes held by the nodes and the leaf index array
+    size_t memoryUsage() const {
+        return _nodes.capacity() * sizeof(BvhNode) + _indices.capacity() * sizeof(int);
+    }
+
+    // Closest hit query. Leaves are visited front to back and skipped once
+    // they start beyond h.getT(); hitPrim(i) tests primitive i, updates h on
+    // a closer hit and returns whether it did.
+    template <typename HitPrim>
+    bool intersect(const Ray &r, float tmin, Hit &h, HitPrim hitPrim) const;
+
+    // Any-hit query over [tmin, tmax]: stops at the first primitive for
+    // which blocks(i) returns true.
+    template <typename BlocksPrim>
+    bool occluded(const Ray &r, float tmin, float tmax, BlocksPrim blocks) const;
+
+    // The same two queries one leaf at a time, for callers that keep their
+    // own per-leaf data: the callbacks get the index of the leaf node.
+    template <typename HitLeaf>
+    bool intersectLeaves(const Ray &r, float tmin, Hit &h, HitLeaf hitLeaf) const;
+
+    template <typename BlocksLeaf>
+    bool occludedLeaves(const Ray &r, float tmin, float tmax, BlocksLeaf blocks) const;
+
+    // Closest hit query for a whole packet, hits[i] belonging to lane i.
+    // A node is entered if any lane enters it; hitPrim(i) tests primitive i
+    // against every lane and returns whether any of them got closer.
+    template <typename HitPrim>
+    bool intersectPacket(const RayPacket &p, Hit *hits, HitPrim hitPrim) const;
+
+    template <typename HitLeaf>
+    bool intersectPacketLeaves(const RayPacket &p, Hit *hits, HitLeaf hitLeaf) const;
+
+  private:
+    int buildNode(const std::vector<Box> &bounds,
+                  const std::vector<Vector3f> &centroids,
+                  int begin, int end, int depth);
+
+    // deep enough for any tree the build produces
+    static const int max_depth = 64;
+    static const int num_bins = 16;
+
+    int _maxLeaf;
+    std::vector<BvhNode> _nodes;
+    std::vector<int> _indices; // leaf slots -> primitive index
+};
+
+template <typename HitPrim>
+bool
+Bvh::intersect(const Ray &r, float tmin, Hit &h, HitPrim hitPrim) const
+{
+    return intersectLeaves(r, tmin, h, [&](int leaf)
+    {
+        const BvhNode &node = _nodes[leaf];
+        bool result = false;
+        for (int ii = node.start; ii < node.start + node.count; ii++) {
+            result |= hitPrim(_indices[ii]);
+        }
+        return result;
+    });
+}
+
+template <typename BlocksPrim>
+bool
+Bvh::occluded(const Ray &r, float tmin, float tmax, BlocksPrim blocks) const
+{
+    return occludedLeaves(r, tmin, tmax, [&](int leaf)
+    {
+        const BvhNode &node = _nodes[leaf];
+        for (int ii = node.start; ii < node.start + node.count; ii++) {
+            if (blocks(_indices[ii])) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+template <typename HitLeaf>
+bool
+Bvh::intersectLeaves(const Ray &r, float tmin, Hit &h, HitLeaf hitLeaf) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    float tnear;
+    if (!_nodes[0].box.intersect(r, tmin, h.getT(), tnear)) {
+        return false;
+    }
+
+    struct Entry
+    {
+        int node;
+        float tnear;
+    };
+    Entry stack[max_depth];
+    int top = 0;
+    stack[top++] = { 0, tnear };
+
+    bool result = false;
+    long long visits = 0;
+    while (top > 0) {
+        Entry e = stack[--top];
+        // a closer hit may have been found since this node was pushed
+        if (e.tnear > h.getT()) {
+            continue;
+        }
+        while (true) {
+            const BvhNode &node = _nodes[e.node];
+            visits++;
+            if (node.isLeaf()) {
+                result |= hitLeaf(e.node);
+                break;
+            }
+            int left = e.node + 1, right = node.start;
+            float tl, tr;
+            bool hl = _nodes[left].box.intersect(r, tmin, h.getT(), tl);
+            bool hr = _nodes[right].box.intersect(r, tmin, h.getT(), tr);
+            if (hl && hr) {
+                // descend into the nearer child, come back for the other
+                if (tr < tl) {
+                    stack[top++] = { left, tl };
+                    e = { right, tr };
+                } else {
+                    stack[top++] = { right, tr };
+                    e = { left, tl };
+                }
+            } else if (hl) {
+                e = { left, tl };
+            } else if (hr) {
+                e = { right, tr };
+            } else {
+                break;
+            }
+        }
+    }
+    Stats::local().nodeVisits += visits;
+    return result;
+}
+
+template <typename BlocksLeaf>
+bool
+Bvh::occludedLeaves(const Ray &r, float tmin, float tmax, BlocksLeaf blocks) const
+{
+    float tnear;
+    if (_nodes.empty() || !_nodes[0].box.intersect(r, tmin, tmax, tnear)) {
+        return false;
+    }
+
+    // order does not matter for an any-hit query: plain depth-first
+    int stack[max_depth];
+    int top = 0;
+    stack[top++] = 0;
+
+    bool result = false;
+    long long visits = 0;
+    while (top > 0 && !result) {
+        int index = stack[--top];
+        const BvhNode &node = _nodes[index];
+        visits++;
+        if (node.isLeaf()) {
+            result = blocks(index);
+            continue;
+        }
+        if (_nodes[node.start].box.intersect(r, tmin, tmax, tnear)) {
+            stack[top++] = node.start;
+        }
+        if (_nodes[index + 1].box.intersect(r, tmin, tmax, tnear)) {
+            stack[top++] = index + 1;
+        }
+    }
+    Stats::local().nodeVisits += visits;
+    return result;
+}
+
+template <typename HitPrim>
+bool
+Bvh::intersectPacket(const RayPacket &p, Hit *hits, HitPrim hitPrim) const
+{
+    return intersectPacketLeaves(p, hits, [&](int leaf)
+    {
+        const BvhNode &node = _nodes[leaf];
+        bool result = false;
+        for (int ii = node.start; ii < node.start + node.count; ii++) {
+            result |= hitPrim(_indices[ii]);
+        }
+        return result;
+    });
+}
+
+template <typename HitLeaf>
+bool
+Bvh::intersectPacketLeaves(const RayPacket &p, Hit *hits, HitLeaf hitLeaf) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    // per-lane closest hit so far, and the farthest of them for culling
+    float tfar[RayPacket::max_size], tfarMax = 0;
+    auto refresh = [&]
+    {
+        tfarMax = 0;
+        for (int i = 0; i < p.size; i++) {
+            tfar[i] = hits[i].getT();
+        }
+        for (int i = 0; i < p.count; i++) {
+            tfarMax = std::max(tfarMax, tfar[i]);
+        }
+    };
+    refresh();
+
+    // the interval test rejects most misses of a coherent packet in one go,
+    // the lane test decides the rest
+    auto enter = [&](int index, float &tnear)
+    {
+        const Box &box = _nodes[index].box;
+        return !p.missesBox(box, tfarMax) && p.intersectBox(box, tfar, tnear) != 0;
+    };
+
+    float tnear;
+    if (!enter(0, tnear)) {
+        return false;
+    }
+
+    struct Entry
+    {
+        int node;
+        float tnear; // earliest entry over the lanes
+    };
+    Entry stack[max_depth];
+    int top = 0;
+    stack[top++] = { 0, tnear };
+
+    bool result = false;
+    long long visits = 0;
+    while (top > 0) {
+        Entry e = stack[--top];
+        if (e.tnear > tfarMax) {
+            continue;
+        }
+        while (true) {
+            const BvhNode &node = _nodes[e.node];
+            visits++;
+            if (node.isLeaf()) {
+                if (hitLeaf(e.node)) {
+                    refresh();
+                    result = true;
+                }
+                break;
+            }
+            int left = e.node + 1, right = node.start;
+            float tl, tr;
+            bool hl = enter(left, tl);
+            bool hr = enter(right, tr);
+            if (hl && hr) {
+                if (tr < tl) {
+                    stack[top++] = { left, tl };
+                    e = { right, tr };
+                } else {
+                    stack[top++] = { right, tr };
+                    e = { left, tl };
+                }
+            } else if (hl) {
+                e = { left, tl };
+            } else if (hr) {
+                e = { right, tr };
+            } else {
+                break;
+            }
+        }
+    }
+    Stats::local().nodeVisits += visits;
+    return result;
+}
+
+#endif // BVH_H
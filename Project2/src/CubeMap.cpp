@@ -1,84 +1,223 @@
 #include "CubeMap.h"
 
+#include "Parallel.h"
+#include "stb_image.h"
+
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 
-CubeMap::CubeMap(const std::string &directory)
+namespace
+{
+// Where the texture coordinates of a face come from: u = (us * d[u] / m +
+// 1) / 2 and the same for v, m being the major axis component of d. v runs
+// bottom up like the rows of an Image.
+struct FaceAxes
+{
+    int u;
+    float us;
+    int v;
+    float vs;
+};
+
+const FaceAxes faceAxes[6] = {
+    {2, 1, 1, -1},  // LEFT
+    {2, 1, 1, 1},   // RIGHT
+    {0, 1, 2, 1},   // UP
+    {0, -1, 2, -1}, // DOWN
+    {0, -1, 1, 1},  // FRONT
+    {0, 1, 1, -1},  // BACK
+};
+
+// the faces along x, y and z: positive, negative
+const int axisFaces[3][2] = {
+    {CubeMap::RIGHT, CubeMap::LEFT},
+    {CubeMap::UP, CubeMap::DOWN},
+    {CubeMap::FRONT, CubeMap::BACK},
+};
+
+struct ByteTable
+{
+    float value[256];
+
+    ByteTable() {
+        for (int i = 0; i < 256; i++) {
+            value[i] = i / 255.0f;
+        }
+    }
+};
+
+const ByteTable byteValue;
+
+uint32_t
+pack(const Vector3f &c)
+{
+    uint32_t p = 0;
+    for (int i = 0; i < 3; i++) {
+        int b = (int)(c[i] * 255 + 0.5f);
+        p |= (uint32_t)std::min(255, std::max(0, b)) << (8 * i);
+    }
+    return p;
+}
+
+Vector3f
+unpack(uint32_t p)
+{
+    return Vector3f(byteValue.value[p & 255], byteValue.value[p >> 8 & 255],
+                    byteValue.value[p >> 16 & 255]);
+}
+}
+
+CubeMap::CubeMap(const std::string &directory, int threads)
 {
     std::string side[6] = { "left", "right", "up", "down", "front", "back" };
-    for(int ii = 0 ;ii<6;ii++){
+    // a face that fails to load is reported once all loaders are done, so
+    // that no worker is still running when exit() tears the process down
+    bool failed[6] = {};
+    parallelFor(6, threads, [&](int ii) {
         std::string filename = directory + "/" + side[ii] + ".png";
-        _images[ii] = Image::loadPNG(filename);
+        int w, h, n;
+        unsigned char *buffer = stbi_load(filename.c_str(), &w, &h, &n, 3);
+        if (!buffer) {
+            failed[ii] = true;
+            return;
+        }
+
+        // the full resolution level straight from the file, rows flipped
+        // so that (0,0) is the bottom left corner as in Image
+        Level level;
+        level.width = w;
+        level.height = h;
+        level.texels.resize((size_t)w * h);
+        for (int y = 0; y < h; y++) {
+            const unsigned char *p = buffer + (size_t)(h - 1 - y) * w * 3;
+            for (int x = 0; x < w; x++, p += 3) {
+                level.texels[(size_t)y * w + x] = p[0] | p[1] << 8 | p[2] << 16;
+            }
+        }
+        stbi_image_free(buffer);
+        _levels[ii].push_back(std::move(level));
+
+        // Every level up halves the one below, each texel the average of
+        // the (up to) 2x2 texels it covers. The averages are kept in float
+        // from one level to the next so that rounding does not pile up.
+        std::vector<Vector3f> texels;
+        while (w > 1 || h > 1) {
+            int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            const std::vector<uint32_t> &below = _levels[ii].back().texels;
+            auto texel = [&](int x, int y) {
+                x = std::min(x, w - 1);
+                y = std::min(y, h - 1);
+                return texels.empty() ? unpack(below[(size_t)y * w + x])
+                                      : texels[(size_t)y * w + x];
+            };
+            std::vector<Vector3f> next((size_t)nw * nh);
+            Level up;
+            up.width = nw;
+            up.height = nh;
+            up.texels.resize(next.size());
+            for (int y = 0; y < nh; y++) {
+                for (int x = 0; x < nw; x++) {
+                    size_t i = (size_t)y * nw + x;
+                    next[i] = (texel(2 * x, 2 * y) + texel(2 * x + 1, 2 * y) +
+                               texel(2 * x, 2 * y + 1) + texel(2 * x + 1, 2 * y + 1)) * 0.25f;
+                    up.texels[i] = pack(next[i]);
+                }
+            }
+            _levels[ii].push_back(std::move(up));
+            texels.swap(next);
+            w = nw;
+            h = nh;
+        }
+    });
+    for (int ii = 0; ii < 6; ii++) {
+        if (failed[ii]) {
+            std::cout << "Cannot open " << directory + "/" + side[ii] + ".png" << "\n";
+            exit(1);
+        }
     }
+}
 
+int
+CubeMap::project(const Vector3f &dir, float &u, float &v, float &cos2)
+{
+    float ax = std::abs(dir[0]), ay = std::abs(dir[1]), az = std::abs(dir[2]);
+    int axis = ax >= ay && ax >= az ? 0 : ay >= az ? 1 : 2;
+    float m = dir[axis];
+    if (m == 0.0f) {
+        return -1;
+    }
+    int face = axisFaces[axis][m < 0.0f];
+    const FaceAxes &a = faceAxes[face];
+    float inv = 1.0f / m;
+    u = (a.us * dir[a.u] * inv + 1.0f) * 0.5f;
+    v = (a.vs * dir[a.v] * inv + 1.0f) * 0.5f;
+    cos2 = m * m / dir.absSquared();
+    return face;
 }
 
+Vector3f
+CubeMap::bilinear(const Level &level, float u, float v) const
+{
+    float x = u * level.width - 0.5f;
+    float y = v * level.height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float alpha = x - fx;
+    float beta = y - fy;
+    int x0 = std::min(std::max((int)fx, 0), level.width - 1);
+    int x1 = std::min(std::max((int)fx + 1, 0), level.width - 1);
+    int y0 = std::min(std::max((int)fy, 0), level.height - 1);
+    int y1 = std::min(std::max((int)fy + 1, 0), level.height - 1);
+    const uint32_t *row0 = &level.texels[(size_t)y0 * level.width];
+    const uint32_t *row1 = &level.texels[(size_t)y1 * level.width];
+
+    return (1 - beta) * ((1 - alpha) * unpack(row0[x0]) + alpha * unpack(row0[x1])) +
+                beta  * ((1 - alpha) * unpack(row1[x0]) + alpha * unpack(row1[x1]));
+}
 
 Vector3f
-CubeMap::getFaceTexel(float x, float y, int face) const
+CubeMap::lookup(int face, float u, float v, float lod) const
 {
-    x = x * _images[face].getWidth();
-    y = (1 - y) * _images[face].getHeight();
-    int ix = (int) x;
-    int iy = (int) y;
-    float alpha = x - ix;
-    float beta = y - iy;
-
-    const Vector3f &pixel0 = getTexturePixel(ix + 0, iy + 0, face);
-    const Vector3f &pixel1 = getTexturePixel(ix + 1, iy + 0, face);
-    const Vector3f &pixel2 = getTexturePixel(ix + 0, iy + 1, face);
-    const Vector3f &pixel3 = getTexturePixel(ix + 1, iy + 1, face);
-
-    Vector3f color;
-    for (int ii = 0; ii < 3; ii++) {
-        color[ii] = 
-              (1 - alpha) * (1 - beta) * pixel0[ii]
-            +      alpha  * (1 - beta) * pixel1[ii]
-            + (1 - alpha) *      beta  * pixel2[ii]
-            +      alpha  *      beta  * pixel3[ii];
+    const std::vector<Level> &levels = _levels[face];
+    lod = std::min(std::max(lod, 0.0f), (float)(levels.size() - 1));
+    int l = (int)lod;
+    float t = lod - l;
+    Vector3f color = bilinear(levels[l], u, v);
+    if (t > 0) {
+        color = (1 - t) * color + t * bilinear(levels[l + 1], u, v);
     }
-
     return color;
 }
 
-
 Vector3f
-CubeMap::getTexel(const Vector3f &direction) const
+CubeMap::getTexel(const Vector3f &direction, float footprint) const
 {
-    Vector3f dir = direction.normalized();
-    Vector3f outputColor(0.0f, 0.0f, 0.0f);
-    if ((std::abs(dir[0]) >= std::abs(dir[1])) && (std::abs(dir[0]) >= std::abs(dir[2]))) {
-        if (dir[0] > 0.0f) {
-            outputColor = 
-                getFaceTexel((dir[2] / dir[0] + 1.0f) * 0.5f, 
-                                   (dir[1] / dir[0] + 1.0f) * 0.5f, RIGHT);
-        } else if (dir[0] < 0.0f) {
-            outputColor = 
-                getFaceTexel(       (dir[2] / dir[0] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[1] / dir[0] + 1.0f) * 0.5f, LEFT);
-        }
-    } else if ((std::abs(dir[1]) >= std::abs(dir[0])) && (std::abs(dir[1]) >= std::abs(dir[2]))) {
-        if (dir[1] > 0.0f) {
-            outputColor = 
-                getFaceTexel((dir[0] / dir[1] + 1.0f) * 0.5f, 
-                                (dir[2] / dir[1] + 1.0f) * 0.5f, UP);
-        } else if (dir[1] < 0.0f) {
-            outputColor = 
-                getFaceTexel(1.0f - (dir[0] / dir[1] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[2] / dir[1] + 1.0f) * 0.5f, DOWN);
-        }
-    } else if ((std::abs(dir[2]) >= std::abs(dir[0])) && (std::abs(dir[2]) >= std::abs(dir[1]))) {
-        if (dir[2] > 0.0f) {
-            outputColor = 
-                getFaceTexel(1.0f - (dir[0] / dir[2] + 1.0f) * 0.5f, 
-                                          (dir[1] / dir[2] + 1.0f) * 0.5f, FRONT);
-        } else if (dir[2] < 0.0f) {
-            outputColor = 
-                getFaceTexel(       (dir[0] / dir[2] + 1.0f) * 0.5f, 
-                                  1.0f - (dir[1] / dir[2] + 1.0f) * 0.5f, BACK);
-        }
+    float u, v, cos2;
+    int face = project(direction, u, v, cos2);
+    if (face < 0) {
+        return Vector3f(0.0f, 0.0f, 0.0f);
     }
 
-    return outputColor;
+    // Texture coordinates run over 2 / width per texel at the face center
+    // and stretch by 1 / cosine^2 towards the edges, along the direction
+    // away from the center.
+    float lod = 0;
+    if (footprint > 0) {
+        float texels = footprint / cos2 * _levels[face][0].width * 0.5f;
+        lod = std::log2(std::max(texels, 1.0f));
+    }
+    return lookup(face, u, v, lod);
+}
+
+Vector3f
+CubeMap::getTexelLod(const Vector3f &direction, float lod) const
+{
+    float u, v, cos2;
+    int face = project(direction, u, v, cos2);
+    if (face < 0) {
+        return Vector3f(0.0f, 0.0f, 0.0f);
+    }
+    return lookup(face, u, v, lod);
 }
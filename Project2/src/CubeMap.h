@@ -4,10 +4,14 @@
 #include "Image.h"
 #include "Vector3f.h"
 
+#include <cstdint>
 #include <string>
-#include "Vector3f.h"
-#include <iostream>
+#include <vector>
 
+// An environment map: six square faces, each with a pyramid of box
+// filtered mip levels down to 1x1 so that lookups covering many texels
+// read one prefiltered texel instead. Texels are stored as 8-bit RGB (the
+// precision of the PNG files) packed in 32 bits.
 class CubeMap {
 public:
     enum FACE {
@@ -19,40 +23,38 @@ public:
         BACK,
     };
 
-    // Assumes a directory containing {left,right,up,down,front,back}.png
-    CubeMap(const std::string &directory);
+    // Assumes a directory containing {left,right,up,down,front,back}.png,
+    // loaded on up to `threads` workers (0 for all cores).
+    CubeMap(const std::string &directory, int threads = 0);
 
-    // Returns color for given directory
-    Vector3f getTexel(const Vector3f &direction) const;
+    // Returns color for given direction, which need not be normalized,
+    // prefiltered over a cone `footprint` radians wide (e.g. the angle
+    // between the camera rays of neighbouring pixels); 0 reads the full
+    // resolution faces.
+    Vector3f getTexel(const Vector3f &direction, float footprint = 0) const;
 
-    // The UV (x, y) coordinates are assumed to be normalized between 0 and 1.
-    // The resulting look up is box filtered in the local 2x2 neighborhood.
-    Vector3f getFaceTexel(float x, float y, int face) const;
+    // The same at a fixed level of detail: 0 is full resolution, every
+    // level up halves it, fractions blend the two levels around.
+    Vector3f getTexelLod(const Vector3f &direction, float lod) const;
 
 private:
-    Image _images[6];
-
-    template<typename T>
-    static T
-        clamp(const T &v, const T &lower_range, const T &upper_range)
+    struct Level
     {
-        if (v < lower_range) {
-            return lower_range;
-        }
-        else if (v > upper_range) {
-            return upper_range;
-        }
-        else {
-            return v;
-        }
-    }
-
-    const Vector3f & getTexturePixel(int x, int y, int face) const {
-        x = clamp(x, 0, _images[face].getWidth() - 1);
-        y = clamp(y, 0, _images[face].getHeight() - 1);
-        return _images[face].getPixel(x, y);
-    }
+        int width, height;
+        std::vector<uint32_t> texels; // rows bottom up like Image
+    };
+
+    // Picks the face of direction, its texture coordinates there and the
+    // squared cosine of its angle to the face's axis; -1 for a zero vector.
+    static int project(const Vector3f &direction, float &u, float &v, float &cos2);
+
+    // Bilinear lookup in a level at coordinates in [0, 1], texel centers
+    // at half texels; the edges are clamped.
+    Vector3f bilinear(const Level &level, float u, float v) const;
+
+    Vector3f lookup(int face, float u, float v, float lod) const;
 
+    std::vector<Level> _levels[6];
 };
 
 #endif
@@ -0,0 +1,61 @@
+#include "Filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Gaussian falloff: exp(-alpha d^2) with d in pixels
+const float gaussianAlpha = 2.0f;
+}
+
+Filter *
+Filter::create(const std::string &name, float radius)
+{
+    if (name == "box") {
+        return new BoxFilter(radius > 0 ? radius : 0.5f);
+    } else if (name == "tent") {
+        return new TentFilter(radius > 0 ? radius : 1.0f);
+    } else if (name == "gaussian") {
+        return new GaussianFilter(radius > 0 ? radius : 1.5f);
+    } else if (name == "mitchell") {
+        return new MitchellFilter(radius > 0 ? radius : 2.0f);
+    }
+    return nullptr;
+}
+
+float
+BoxFilter::evaluate(float) const
+{
+    return 1;
+}
+
+float
+TentFilter::evaluate(float d) const
+{
+    return std::max(0.0f, radius() - std::fabs(d));
+}
+
+float
+GaussianFilter::evaluate(float d) const
+{
+    float r = radius();
+    return std::max(0.0f, std::exp(-gaussianAlpha * d * d) -
+                              std::exp(-gaussianAlpha * r * r));
+}
+
+float
+MitchellFilter::evaluate(float d) const
+{
+    const float B = 1.0f / 3, C = 1.0f / 3;
+    float x = std::fabs(2 * d / radius());
+    if (x > 2) {
+        return 0;
+    }
+    if (x > 1) {
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x +
+                (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6;
+    }
+    return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x +
+            (6 - 2 * B)) / 6;
+}
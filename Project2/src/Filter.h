@@ -0,0 +1,69 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <string>
+
+// A separable pixel reconstruction filter. Every camera sample is splatted
+// into the pixels within `radius` of it (see SplatBuffer), each weighted by
+// the filter at its offset from the pixel center, and a pixel ends up as
+// the weighted average of the samples around it.
+class Filter
+{
+  public:
+    Filter(float radius) : _radius(radius) { }
+    virtual ~Filter() { }
+
+    // Maps "box", "tent", "gaussian" or "mitchell" to a new filter of the
+    // given radius in pixels, the filter's own default for radius 0;
+    // nullptr for anything else.
+    static Filter *create(const std::string &name, float radius);
+
+    float radius() const {
+        return _radius;
+    }
+
+    // Weight at offset d (in pixels) along one axis, |d| < radius.
+    virtual float evaluate(float d) const = 0;
+
+  private:
+    float _radius;
+};
+
+// Constant weight: a plain average of the samples around a pixel.
+class BoxFilter : public Filter
+{
+  public:
+    BoxFilter(float radius) : Filter(radius) { }
+
+    virtual float evaluate(float d) const override;
+};
+
+// Linear falloff to zero at the radius.
+class TentFilter : public Filter
+{
+  public:
+    TentFilter(float radius) : Filter(radius) { }
+
+    virtual float evaluate(float d) const override;
+};
+
+// A Gaussian shifted down to reach zero at the radius.
+class GaussianFilter : public Filter
+{
+  public:
+    GaussianFilter(float radius) : Filter(radius) { }
+
+    virtual float evaluate(float d) const override;
+};
+
+// The Mitchell-Netravali cubic with B = C = 1/3, stretched over the radius.
+// Its negative lobes sharpen edges; it can ring on very high contrast.
+class MitchellFilter : public Filter
+{
+  public:
+    MitchellFilter(float radius) : Filter(radius) { }
+
+    virtual float evaluate(float d) const override;
+};
+
+#endif // FILTER_H
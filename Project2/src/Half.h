@@ -0,0 +1,69 @@
+#ifndef HALF_H
+#define HALF_H
+
+// IEEE 754 binary16 ("half") conversions. Float to half rounds to nearest
+// even, overflows to infinity and keeps NaNs NaN; half to float is exact.
+// With F16C the hardware instructions do the same.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+inline uint16_t
+floatToHalf(float f)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(f, 0);
+#else
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    uint32_t sign = x >> 16 & 0x8000;
+    x &= 0x7fffffff;
+    if (x >= 0x47800000) {
+        // 65536 and up, infinity, NaN
+        return (uint16_t)(sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00));
+    }
+    if (x < 0x38800000) {
+        // below the smallest normal half: adding 0.5 lines the bits up
+        // with the half subnormal ones and rounds them in the FPU
+        float a;
+        memcpy(&a, &x, 4);
+        a += 0.5f;
+        memcpy(&x, &a, 4);
+        return (uint16_t)(sign | (x - 0x3f000000));
+    }
+    // rebias the exponent and round the 13 dropped bits to nearest even;
+    // a carry out of the mantissa bumps the exponent, up to infinity
+    x += 0xc8000fff + (x >> 13 & 1);
+    return (uint16_t)(sign | x >> 13);
+#endif
+}
+
+inline float
+halfToFloat(uint16_t h)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = h >> 10 & 0x1f, mantissa = h & 0x3ff;
+    uint32_t x;
+    if (!exponent) {
+        float f = mantissa * (1.0f / 16777216); // subnormal: mantissa * 2^-24
+        memcpy(&x, &f, 4);
+    } else if (exponent == 31) {
+        x = 0x7f800000 | mantissa << 13;
+    } else {
+        x = (exponent + 112) << 23 | mantissa << 13;
+    }
+    x |= sign;
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+#endif
+}
+
+#endif // HALF_H
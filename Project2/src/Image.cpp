@@ -1,49 +1,204 @@
+#include <algorithm>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
 #include <cassert>
 
 #include "Image.h"
+#include "PngWriter.h"
+#include "Simd.h"
 
 #include "stb_image.h"
-#include "stb_image_write.h"
 
-static
-uint8_t
-clampColorComponent(float c)
+bool
+Image::savePNG(const std::string &filename, int threads) const
 {
-    int tmp = int(c * 255);
+    assert(!filename.empty());
+
+    // PngWriter takes the rows from the top, so (0,0) is bottom left corner
+    PngWriter writer(filename, _width, _height, threads);
+    writer.write(*this);
+    return writer.finish();
+}
 
-    if (tmp < 0) {
-        tmp = 0;
+void
+Image::rowBytes(int y, uint8_t *out) const
+{
+    // Each channel is scaled, truncated and clamped to [0, 255] a vector of
+    // pixels at a time (the block padding makes the last vector safe to
+    // load), then the three are interleaved. Clamping after the conversion
+    // keeps infinities and NaNs (a miss in the depth image) black.
+    static_assert(blockWidth % SIMD_WIDTH == 0, "vectors must not straddle blocks");
+    uint8_t q[3][SIMD_WIDTH];
+    for (int x = 0; x < _width; x += SIMD_WIDTH) {
+        for (int c = 0; c < 3; c++) {
+            size_t i = index(x, y) + c * blockWidth;
+            vfloat v = _format == Float
+                ? vfloat::load((const float *)_data.data() + i)
+                : loadHalf((const uint16_t *)_data.data() + i);
+            storeBytes(v * vfloat(255.0f), q[c]);
+        }
+        int n = std::min(SIMD_WIDTH, _width - x);
+        for (int k = 0; k < n; k++) {
+            *out++ = q[0][k];
+            *out++ = q[1][k];
+            *out++ = q[2][k];
+        }
     }
+}
+
+bool
+Image::savePFM(const std::string &filename) const
+{
+    assert(!filename.empty());
 
-    if (tmp > 255) {
-        tmp = 255;
+    // A negative scale marks little-endian floats. The header and the
+    // pixels go out in one write.
+    uint32_t one = 1;
+    bool little = *(const uint8_t *)&one == 1;
+    char header[64];
+    int length = snprintf(header, sizeof(header), "PF\n%d %d\n%s\n", _width, _height,
+                          little ? "-1.0" : "1.0");
+    size_t row = (size_t)_width * 3 * sizeof(float);
+    std::vector<uint8_t> buffer(length + row * _height);
+    memcpy(buffer.data(), header, length);
+    for (int y = 0; y < _height; y++) {
+        float *out = (float *)(buffer.data() + length + row * y);
+        for (int x = 0; x < _width; x++) {
+            Vector3f pixel = getPixel(x, y);
+            *out++ = pixel[0];
+            *out++ = pixel[1];
+            *out++ = pixel[2];
+        }
     }
 
-    return uint8_t(tmp);
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    ok &= fclose(file) == 0;
+    return ok;
 }
 
+namespace
+{
 void
-Image::savePNG(const std::string &filename) const
+putBytes(std::vector<uint8_t> &out, const void *data, size_t size)
 {
-    assert(!filename.empty());
+    out.insert(out.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+}
 
-    std::vector<uint8_t> buffer;
-    buffer.resize(_width * _height * 3);
+// OpenEXR is little-endian throughout
+void
+putInt(std::vector<uint8_t> &out, uint64_t value, int size)
+{
+    for (int i = 0; i < size; i++) {
+        out.push_back((uint8_t)(value >> 8 * i));
+    }
+}
 
-    // flip y so that (0,0) is bottom left corner
-    for (int c = 0, y = _height - 1; y >= 0; y--) {
-        for (int x = 0; x < _width; x++) {
-            const Vector3f &pixel = getPixel(x, y);
-            buffer[c++] = clampColorComponent(pixel[0]);
-            buffer[c++] = clampColorComponent(pixel[1]);
-            buffer[c++] = clampColorComponent(pixel[2]);
+void
+putFloat(std::vector<uint8_t> &out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    putInt(out, bits, 4);
+}
+
+void
+attribute(std::vector<uint8_t> &out, const char *name, const char *type, int size)
+{
+    putBytes(out, name, strlen(name) + 1);
+    putBytes(out, type, strlen(type) + 1);
+    putInt(out, size, 4);
+}
+}
+
+bool
+Image::saveEXR(const std::string &filename) const
+{
+    assert(!filename.empty());
+
+    // OpenEXR 2 single-part scanline file: magic and version, the header
+    // attributes that every file needs, then a table with the offset of
+    // every line and the lines, top first, each channel in a run.
+    int valueSize = _format == Float ? 4 : 2;
+    std::vector<uint8_t> out;
+    putInt(out, 20000630, 4);
+    putInt(out, 2, 4);
+
+    // channels in alphabetical order; type 1 is HALF, 2 is FLOAT
+    const char *channels[3] = {"B", "G", "R"};
+    attribute(out, "channels", "chlist", 3 * 18 + 1);
+    for (const char *name : channels) {
+        putBytes(out, name, 2);
+        putInt(out, _format == Float ? 2 : 1, 4);
+        putInt(out, 0, 4); // pLinear and reserved
+        putInt(out, 1, 4); // x and y sampling
+        putInt(out, 1, 4);
+    }
+    out.push_back(0);
+    attribute(out, "compression", "compression", 1);
+    out.push_back(0); // NO_COMPRESSION
+    for (const char *window : {"dataWindow", "displayWindow"}) {
+        attribute(out, window, "box2i", 16);
+        putInt(out, 0, 4);
+        putInt(out, 0, 4);
+        putInt(out, _width - 1, 4);
+        putInt(out, _height - 1, 4);
+    }
+    attribute(out, "lineOrder", "lineOrder", 1);
+    out.push_back(0); // INCREASING_Y
+    attribute(out, "pixelAspectRatio", "float", 4);
+    putFloat(out, 1);
+    attribute(out, "screenWindowCenter", "v2f", 8);
+    putFloat(out, 0);
+    putFloat(out, 0);
+    attribute(out, "screenWindowWidth", "float", 4);
+    putFloat(out, 1);
+    out.push_back(0);
+
+    size_t line = (size_t)_width * 3 * valueSize;
+    size_t table = out.size(), lines = table + (size_t)_height * 8;
+    out.resize(lines + (8 + line) * _height);
+    for (int y = 0; y < _height; y++) {
+        size_t offset = lines + (8 + line) * y;
+        for (int i = 0; i < 8; i++) {
+            out[table + 8 * y + i] = (uint8_t)(offset >> 8 * i);
+        }
+        // EXR line y is image row _height - 1 - y
+        uint8_t *p = &out[offset];
+        for (int i = 0; i < 4; i++) {
+            p[i] = (uint8_t)(y >> 8 * i);
+            p[4 + i] = (uint8_t)(line >> 8 * i);
+        }
+        p += 8;
+        for (int c = 2; c >= 0; c--, p += (size_t)_width * valueSize) {
+            rowChannel(_height - 1 - y, c, p);
         }
     }
 
-    stbi_write_png(filename.c_str(), _width, _height, 3, &buffer[0], _width * 3);
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok &= fclose(file) == 0;
+    return ok;
+}
+
+// The values are copied as stored: a little-endian host is assumed, as for
+// the mesh cache.
+void
+Image::rowChannel(int y, int c, uint8_t *out) const
+{
+    int valueSize = _format == Float ? 4 : 2;
+    for (int x = 0; x < _width; x += blockWidth) {
+        size_t n = std::min(blockWidth, _width - x) * valueSize;
+        memcpy(out, _data.data() + (index(x, y) + c * blockWidth) * valueSize, n);
+        out += n;
+    }
 }
 
 Image 
@@ -58,13 +213,11 @@ Image::loadPNG(const std::string &filename)
 
     Image image(w, h);
 
-    // flip y so that (0,0) is bottom left corner
-    for (int c = 0, p = 0, y = h - 1; y >= 0; y--) {
-        for (int x = 0; x < w; x++, ++p) {
-            Vector3f &pixel = image._data[p];
-            pixel[0] = buffer[c++] / 255.0f;
-            pixel[1] = buffer[c++] / 255.0f;
-            pixel[2] = buffer[c++] / 255.0f;
+    // the rows stay in file order, top row at y = 0
+    for (int c = 0, y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++, c += 3) {
+            image.setPixel(x, y, Vector3f(buffer[c] / 255.0f, buffer[c + 1] / 255.0f,
+                                          buffer[c + 2] / 255.0f));
         }
     }
     stbi_image_free(buffer);
@@ -84,8 +237,8 @@ Image::compare(const Image& img1, const Image & img2)
     const int height = img1.getHeight();
     for (int x = 0; x < width; x++) {
         for (int y = 0; y < height; y++) {
-            const Vector3f &color1 = img1.getPixel(x, y);
-            const Vector3f &color2 = img2.getPixel(x, y);
+            Vector3f color1 = img1.getPixel(x, y);
+            Vector3f color2 = img2.getPixel(x, y);
             Vector3f color3 =
                 Vector3f(fabs(color1[0] - color2[0]),
                          fabs(color1[1] - color2[1]),
@@ -2,23 +2,60 @@
 #define IMAGE_H
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
 #include <vector>
 
+#include "Half.h"
 #include "vecmath.h"
 
+// Allocator for the pixels: aligned for the widest vector loads.
+template <typename T>
+struct AlignedAllocator
+{
+    typedef T value_type;
+    static const size_t alignment = 64;
+
+    AlignedAllocator() {}
+    template <typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+
+    template <typename U> bool operator==(const AlignedAllocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U> &) const { return false; }
+};
+
 // Simple image class
+//
+// The pixels are stored as 32-bit floats, or as half floats at half the
+// memory, planar in blocks of 8 pixels along a row: the block's 8 red
+// values, then its 8 green ones, then its 8 blue ones. A channel of a block
+// is a vector load, while a pixel's channels stay on the same cache line
+// for renderers writing in small tiles (whole planes, or planar rows, make
+// those writes several times slower). The last block of a row is padded
+// with zeros.
 class Image
 {
 public:
-    Image() : _width(0), _height(0) {}
+    enum Format { Float, Half };
+
+    Image() : _width(0), _height(0), _stride(0), _format(Float) {}
     // Instantiate an image of given width and height
     // All pixels are set to black (0, 0, 0) by default.
-    Image(int w, int h)
+    Image(int w, int h, Format format = Float)
     {
         _width = w;
         _height = h;
-        _data.resize(_width * _height);
+        _stride = (w + blockWidth - 1) / blockWidth * blockWidth * 3;
+        _format = format;
+        _data.resize((size_t)_stride * h * (format == Float ? 4 : 2));
     }
 
     // Return width of image
@@ -31,40 +68,91 @@ public:
         return _height;
     }
 
+    Format getFormat() const {
+        return _format;
+    }
+
     // Set pixel to given RGB
     void setPixel(int x, int y, const Vector3f &color) {
         assert(x >= 0 && x < _width);
         assert(y >= 0 && y < _height);
-        _data[y * _width + x] = color;
+        size_t i = index(x, y);
+        if (_format == Float) {
+            float *p = (float *)_data.data() + i;
+            p[0] = color[0];
+            p[blockWidth] = color[1];
+            p[2 * blockWidth] = color[2];
+        } else {
+            uint16_t *p = (uint16_t *)_data.data() + i;
+            p[0] = floatToHalf(color[0]);
+            p[blockWidth] = floatToHalf(color[1]);
+            p[2 * blockWidth] = floatToHalf(color[2]);
+        }
     }
 
     // Return pixel at given x, y coordinates
-    const Vector3f & getPixel(int x, int y) const {
+    Vector3f getPixel(int x, int y) const {
         assert(x >= 0 && x < _width);
         assert(y >= 0 && y < _height);
-        return _data[y * _width + x];
+        size_t i = index(x, y);
+        if (_format == Float) {
+            const float *p = (const float *)_data.data() + i;
+            return Vector3f(p[0], p[blockWidth], p[2 * blockWidth]);
+        }
+        const uint16_t *p = (const uint16_t *)_data.data() + i;
+        return Vector3f(halfToFloat(p[0]), halfToFloat(p[blockWidth]),
+                        halfToFloat(p[2 * blockWidth]));
     }
 
     // Initialize all pixels in image to given RGB color.
     void setAllPixels(const Vector3f &color) {
-        for (int i = 0; i < _width * _height; ++i) {
-            _data[i] = color;
+        for (int y = 0; y < _height; ++y) {
+            for (int x = 0; x < _width; ++x) {
+                setPixel(x, y, color);
+            }
         }
     }
 
     // Reads PNG image and return new image instance.
     static Image loadPNG(const std::string &filename);
 
-    // Save contents of image to given file name in PNG file format.
-    void savePNG(const std::string &filename) const;
+    // Save contents of image to given file name in PNG file format,
+    // encoded on up to `threads` workers (0 for all cores). Returns false
+    // if the file could not be written.
+    bool savePNG(const std::string &filename, int threads = 0) const;
+
+    // Save the unclamped float values to a PFM file, bottom row first as
+    // the format wants. Returns false if the file could not be written.
+    bool savePFM(const std::string &filename) const;
+
+    // Save the values to an uncompressed scanline OpenEXR file with R, G
+    // and B channels of the image's format (float or half). Returns false
+    // if the file could not be written.
+    bool saveEXR(const std::string &filename) const;
+
+    // Row y as 8-bit RGB, clamped to [0, 1] as savePNG() writes it.
+    void rowBytes(int y, uint8_t *out) const;
 
     // Return an absolute difference betweenthe given images
     static Image compare(const Image & img1, const Image & img2);
 
 private:
+    // pixels per block; a multiple of SIMD_WIDTH
+    static constexpr int blockWidth = 8;
+
+    // the red value of pixel (x, y); green and blue follow blockWidth apart
+    size_t index(int x, int y) const {
+        return (size_t)y * _stride + x / blockWidth * 3 * blockWidth + x % blockWidth;
+    }
+
+    // Copies channel c of row y to out as stored, 4 or 2 bytes a value.
+    void rowChannel(int y, int c, uint8_t *out) const;
+
     int _width;
     int _height;
-    std::vector<Vector3f> _data;
+    int _stride; // values per row, padding included
+    Format _format;
+    std::vector<uint8_t, AlignedAllocator<uint8_t>> _data;
 };
 
 #endif // IMAGE_H
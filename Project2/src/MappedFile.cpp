@@ -0,0 +1,122 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+    _data(nullptr),
+    _size(0)
+#ifdef _WIN32
+    , _file(INVALID_HANDLE_VALUE),
+    _mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool
+MappedFile::open(const std::string &filename)
+{
+    close();
+    _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size)) {
+        close();
+        return false;
+    }
+    _size = (size_t)size.QuadPart;
+    if (_size == 0) {
+        return true; // nothing to map
+    }
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!_mapping) {
+        close();
+        return false;
+    }
+    _data = (const char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!_data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void
+MappedFile::close()
+{
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _size = 0;
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool
+MappedFile::open(const std::string &filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    _size = (size_t)st.st_size;
+    if (_size == 0) {
+        ::close(fd);
+        return true; // mmap refuses empty ranges
+    }
+    void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (p == MAP_FAILED) {
+        _size = 0;
+        return false;
+    }
+#ifdef MADV_WILLNEED
+    // readers touch the whole file, from several threads at once
+    madvise(p, _size, MADV_WILLNEED);
+#endif
+    _data = (const char *)p;
+    return true;
+}
+
+void
+MappedFile::close()
+{
+    if (_data) {
+        munmap((void *)_data, _size);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
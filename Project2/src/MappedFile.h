@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only into memory. Pages are read in on first
+// touch, so parsers can work on the bytes in place (and from several
+// threads) without copying them into a buffer first.
+class MappedFile
+{
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    // Maps filename, replacing any earlier mapping; false if the file
+    // cannot be opened or mapped.
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const {
+        return _data;
+    }
+    size_t size() const {
+        return _size;
+    }
+
+  private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *_data;
+    size_t _size;
+#ifdef _WIN32
+    void *_file;
+    void *_mapping;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -1,137 +1,468 @@
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ObjFile.h"
+#include "Parallel.h"
+#include "Stats.h"
 
-#include <fstream>
-#include <iostream>
+#include <chrono>
 #include <algorithm>
 #include <cstdlib>
+#include <iostream>
 #include <utility>
-#include <sstream>
 
-Mesh::Mesh(const std::string &filename, Material *material) :
-    Object3D(material)
+bool
+Mesh::parseAccel(const std::string &name, Accel &accel)
 {
-    std::ifstream f;
-    f.open(filename.c_str());
-    if (!f.is_open()) {
+    if (name == "none") {
+        accel = NONE;
+    } else if (name == "octree") {
+        accel = OCTREE;
+    } else if (name == "bvh") {
+        accel = BVH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *
+Mesh::accelName(Accel accel)
+{
+    switch (accel) {
+    case NONE:
+        return "none";
+    case OCTREE:
+        return "octree";
+    default:
+        return "bvh";
+    }
+}
+
+Mesh::Mesh(const std::string &filename, Material *material, Accel accel, int threads,
+           bool cache) :
+    Object3D(material),
+    _accel(accel)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(filename)) {
         std::cout << "Cannot open " << filename << "\n";
         return;
     }
+    TraceStats &stats = Stats::local();
+    stats.loadBytes += file.size();
 
-    std::vector<Vector3f> v;
-    std::vector<ObjTriangle> t;
-    std::vector<Vector3f> n;
-    std::vector<Vector2f> texCoord;
-
-    const std::string vTok("v");
-    const std::string fTok("f");
-    const std::string texTok("vt");
-    const char bslash = '/', space = ' ';
-    std::string tok;
-    std::string line;
-    while (true) {
-        std::getline(f, line);
-        if (f.eof()) {
-            break;
-        }
-        if (line.size() < 3) {
-            continue;
+    // the cache stands in for both the parse and the build below
+    CacheHeader header(_accel, file.size(), 0);
+    std::string path = cachePath(filename, accelName(_accel));
+    if (cache) {
+        header.objHash = hashBytes(file.data(), file.size(), threads);
+        // unmapped while the cache is read, to keep the peak memory down
+        file.close();
+        if (loadCache(path, header)) {
+            stats.cacheHits++;
+            stats.loadSeconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - loadStart).count();
+            countMemory();
+            return;
         }
-        if (line.at(0) == '#') {
-            continue;
+        stats.cacheMisses++;
+        if (!file.open(filename)) {
+            std::cout << "Cannot open " << filename << "\n";
+            return;
         }
-        std::stringstream ss(line);
-        ss >> tok;
-        if (tok == vTok) {
-            Vector3f vec;
-            ss >> vec[0] >> vec[1] >> vec[2];
-            v.push_back(vec);
+    }
+
+    ObjFile obj;
+    if (!obj.read(file.data(), file.size(), filename, threads)) {
+        return;
+    }
+    file.close();
+    _vertices = std::move(obj.vertices);
+    _indices = std::move(obj.indices);
+    if (obj.normalIndices.empty()) {
+        smoothNormals(threads);
+    } else {
+        _normals = std::move(obj.normals);
+        _normalIndices = std::move(obj.normalIndices);
+    }
+    stats.loadSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - loadStart).count();
+
+    auto start = std::chrono::steady_clock::now();
+    buildAccel(threads);
+    stats.buildSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    countMemory();
+
+    if (cache && !_indices.empty() && !saveCache(path, header)) {
+        std::cout << "Cannot write mesh cache " << path << "\n";
+    }
+}
+
+void
+Mesh::buildAccel(int threads)
+{
+    if (_accel == BVH) {
+        std::vector<Box> bounds(triangleCount());
+        for (int ii = 0; ii < triangleCount(); ii++) {
+            bounds[ii] = triangleBounds(ii);
         }
-        else if (tok == fTok) {
-            if (line.find(bslash) != std::string::npos) {
-                std::replace(line.begin(), line.end(), bslash, space);
-                std::stringstream facess(line);
-                ObjTriangle trig;
-                facess >> tok;
-                for (int ii = 0; ii < 3; ii++) {
-                    facess >> trig[ii] >> trig.texID[ii];
-                    trig[ii]--;
-                    trig.texID[ii]--;
-                }
-                t.push_back(trig);
-            }
-            else {
-                ObjTriangle trig;
-                for (int ii = 0; ii < 3; ii++) {
-                    ss >> trig[ii];
-                    trig[ii]--;
-                    trig.texID[ii] = 0;
-                }
-                t.push_back(trig);
+        bvh.build(bounds);
+        const std::vector<BvhNode> &nodes = bvh.nodes();
+        _leafBlocks.assign(nodes.size(), -1);
+        for (size_t ii = 0; ii < nodes.size(); ii++) {
+            if (nodes[ii].isLeaf()) {
+                _leafBlocks[ii] = packBlocks(&bvh.indices()[nodes[ii].start], nodes[ii].count, _blocks);
             }
         }
-        else if (tok == texTok) {
-            Vector2f texcoord;
-            ss >> texcoord[0];
-            ss >> texcoord[1];
-            texCoord.push_back(texcoord);
+    } else if (_accel == OCTREE) {
+        octree.build(this, threads);
+    } else {
+        std::vector<int> all(triangleCount());
+        for (size_t ii = 0; ii < all.size(); ii++) {
+            all[ii] = (int)ii;
         }
+        packBlocks(all.data(), (int)all.size(), _blocks);
     }
-    f.close();
-
-    // Compute normals
-    // will smooth normals.
-    // if sharp edges required, build OBJ with no shared vertices.
-    n.resize(v.size());
-    for (int ii = 0; ii < t.size(); ii++) {
-        Vector3f a = v[t[ii][1]] - v[t[ii][0]];
-        Vector3f b = v[t[ii][2]] - v[t[ii][0]];
-        Vector3f normal = Vector3f::cross(a, b).normalized();
-        for (int jj = 0; jj < 3; jj++) {
-            n[t[ii][jj]] += normal;
-        }
+    _blocks.shrink_to_fit();
+}
+
+bool
+Mesh::loadCache(const std::string &path, const CacheHeader &header)
+{
+    MappedFile file;
+    CacheHeader stored(0, 0, 0);
+    if (!file.open(path)) {
+        return false;
+    }
+    CacheReader in(file.data(), file.size());
+    if (!in.value(stored) || !(stored == header)) {
+        return false;
     }
-    for (int ii = 0; ii < v.size(); ii++) {
-        n[ii] = n[ii] / n[ii].abs();
+    bool ok = in.array(_vertices) && in.array(_normals) &&
+              in.array(_indices) && in.array(_normalIndices) &&
+              in.array(_blocks) && in.array(_leafBlocks);
+    if (ok && _accel == OCTREE) {
+        ok = octree.load(in, this);
+    } else if (ok && _accel == BVH) {
+        ok = bvh.load(in);
     }
+    if (!ok || !in.atEnd()) {
+        // unreadable after all: start over from the OBJ file
+        _vertices.clear();
+        _normals.clear();
+        _indices.clear();
+        _normalIndices.clear();
+        _blocks.clear();
+        _leafBlocks.clear();
+        return false;
+    }
+    return true;
+}
 
-    // Set up triangles
-    for (int i = 0; i < t.size(); i++) {
-        Triangle triangle(v[t[i][0]],
-            v[t[i][1]],
-            v[t[i][2]],
-            n[t[i][0]],
-            n[t[i][1]],
-            n[t[i][2]],
-            getMaterial());
-        _triangles.push_back(triangle);
+bool
+Mesh::saveCache(const std::string &path, const CacheHeader &header) const
+{
+    CacheWriter out;
+    out.value(header);
+    out.array(_vertices);
+    out.array(_normals);
+    out.array(_indices);
+    out.array(_normalIndices);
+    out.array(_blocks);
+    out.array(_leafBlocks);
+    if (_accel == OCTREE) {
+        octree.save(out);
+    } else if (_accel == BVH) {
+        bvh.save(out);
     }
+    return out.save(path);
+}
 
-    octree.build(this);
+void
+Mesh::countMemory() const
+{
+    size_t bytes = _blocks.capacity() * sizeof(TriangleBlock);
+    if (_accel == BVH) {
+        bytes += bvh.memoryUsage() + _leafBlocks.capacity() * sizeof(int);
+    } else if (_accel == OCTREE) {
+        bytes += octree.memoryUsage();
+    }
+    TraceStats &stats = Stats::local();
+    stats.accelBytes += bytes;
+    stats.meshBytes += _vertices.capacity() * sizeof(Vector3f) +
+                       _normals.capacity() * sizeof(Vector3f) +
+                       (_indices.capacity() + _normalIndices.capacity()) * sizeof(uint32_t);
+}
+
+void
+Mesh::smoothNormals(int threads)
+{
+    // Sharp edges need unshared vertices in the OBJ file. Every vertex sums
+    // its faces in file order, so the result is the same for any number of
+    // threads.
+    const size_t grain = 16384;
+    std::vector<Vector3f> faceNormals(triangleCount());
+    parallelRanges(faceNormals.size(), grain, threads, [&](size_t begin, size_t end) {
+        for (size_t ii = begin; ii < end; ii++) {
+            Vector3f a = vertex((int)ii, 1) - vertex((int)ii, 0);
+            Vector3f b = vertex((int)ii, 2) - vertex((int)ii, 0);
+            faceNormals[ii] = Vector3f::cross(a, b).normalized();
+        }
+    });
+
+    // the faces around each vertex: faces[first[v], first[v + 1])
+    std::vector<uint32_t> first(_vertices.size() + 1, 0), faces(_indices.size());
+    for (uint32_t v : _indices) {
+        first[v + 1]++;
+    }
+    for (size_t ii = 0; ii < _vertices.size(); ii++) {
+        first[ii + 1] += first[ii];
+    }
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t ii = 0; ii < _indices.size(); ii++) {
+        faces[fill[_indices[ii]]++] = (uint32_t)(ii / 3);
+    }
+
+    _normals.resize(_vertices.size());
+    parallelRanges(_vertices.size(), grain, threads, [&](size_t begin, size_t end) {
+        for (size_t ii = begin; ii < end; ii++) {
+            Vector3f n;
+            for (uint32_t k = first[ii]; k < first[ii + 1]; k++) {
+                n += faceNormals[faces[k]];
+            }
+            _normals[ii] = n / n.abs();
+        }
+    });
+}
+
+Box
+Mesh::triangleBounds(int trig) const
+{
+    Box box(vertex(trig, 0), vertex(trig, 0));
+    box.expand(vertex(trig, 1));
+    box.expand(vertex(trig, 2));
+    return box;
+}
+
+Vector3f
+Mesh::normalAt(int trig, float beta, float gamma) const
+{
+    const uint32_t *v = _normalIndices.empty() ? &_indices[3 * trig] : &_normalIndices[3 * trig];
+    return ((1 - beta - gamma) * _normals[v[0]] + beta * _normals[v[1]] + gamma * _normals[v[2]]).normalized();
 }
 
 bool
 Mesh::intersect(const Ray &r, float tmin, Hit &h) const
 {
-#if 1
-    ray = &r;
-    hit = &h;
-    tm = tmin;
-    return octree.intersect(r);
-#else
+    if (_accel == OCTREE) {
+        return octree.intersect(r, tmin, h);
+    }
+
+    long long tests = 0;
+    bool result = false;
+    if (_accel == BVH) {
+        result = bvh.intersectLeaves(r, tmin, h, [&](int leaf) {
+            int count = bvh.nodes()[leaf].count;
+            tests += count;
+            return intersectBlocks(&_blocks[_leafBlocks[leaf]], TriangleBlock::blocksFor(count),
+                                   r, tmin, h);
+        });
+    } else {
+        tests += triangleCount();
+        result = intersectBlocks(_blocks.data(), (int)_blocks.size(), r, tmin, h);
+    }
+    Stats::local().triangleTests += tests;
+    return result;
+}
+
+bool
+Mesh::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    if (_accel == OCTREE) {
+        return Object3D::intersectPacket(p, hits);
+    }
+
+    long long tests = 0;
     bool result = false;
-    for (Triangle t : _triangles) {
-        if (t.intersect(r, tmin, h)) {
-            result = true;
+    if (_accel == BVH) {
+        result = bvh.intersectPacketLeaves(p, hits, [&](int leaf) {
+            int count = bvh.nodes()[leaf].count;
+            tests += (long long)count * p.count;
+            return intersectBlocks(&_blocks[_leafBlocks[leaf]], TriangleBlock::blocksFor(count),
+                                   p, hits);
+        });
+    } else {
+        tests += (long long)triangleCount() * p.count;
+        result = intersectBlocks(_blocks.data(), (int)_blocks.size(), p, hits);
+    }
+    Stats::local().triangleTests += tests;
+    return result;
+}
+
+bool
+Mesh::occluded(const Ray &r, float tmin, float tmax) const
+{
+    if (_accel == OCTREE) {
+        return octree.occluded(r, tmin, tmax);
+    }
+
+    long long tests = 0;
+    bool result = false;
+    if (_accel == BVH) {
+        result = bvh.occludedLeaves(r, tmin, tmax, [&](int leaf) {
+            int count = bvh.nodes()[leaf].count;
+            tests += count;
+            return occludedBlocks(&_blocks[_leafBlocks[leaf]], TriangleBlock::blocksFor(count),
+                                  r, tmin, tmax);
+        });
+    } else {
+        tests += triangleCount();
+        result = occludedBlocks(_blocks.data(), (int)_blocks.size(), r, tmin, tmax);
+    }
+    Stats::local().triangleTests += tests;
+    return result;
+}
+
+bool
+Mesh::getBounds(Box &box) const
+{
+    if (_indices.empty()) {
+        return false;
+    }
+    if (_accel == OCTREE) {
+        box = octree.bounds();
+    } else if (_accel == BVH) {
+        box = bvh.bounds();
+    } else {
+        box = Box::empty();
+        for (int ii = 0; ii < triangleCount(); ii++) {
+            box.expand(triangleBounds(ii));
         }
     }
+    return true;
+}
+
+int
+Mesh::packBlocks(const int *trigs, int n, std::vector<TriangleBlock> &blocks) const
+{
+    int first = (int)blocks.size();
+    blocks.resize(first + TriangleBlock::blocksFor(n));
+    for (int ii = 0; ii < n; ii++) {
+        blocks[first + ii / SIMD_WIDTH].set(ii % SIMD_WIDTH, vertex(trigs[ii], 0),
+                                            vertex(trigs[ii], 1), vertex(trigs[ii], 2), trigs[ii]);
+    }
+    return first;
+}
+
+bool
+Mesh::intersectTrigs(const int *trigs, int n, const Ray &r, float tmin, Hit &h) const
+{
+    bool result = false;
+    TriangleBlock block;
+    for (int ii = 0; ii < n; ii += SIMD_WIDTH) {
+        block.gather(_vertices.data(), _indices.data(), trigs + ii, std::min(n - ii, SIMD_WIDTH));
+        result |= intersectBlocks(&block, 1, r, tmin, h);
+    }
     return result;
-#endif
 }
 
 bool
-Mesh::intersectTrig(int idx, const Ray &r) const
+Mesh::occludedTrigs(const int *trigs, int n, const Ray &r, float tmin, float tmax) const
+{
+    TriangleBlock block;
+    for (int ii = 0; ii < n; ii += SIMD_WIDTH) {
+        block.gather(_vertices.data(), _indices.data(), trigs + ii, std::min(n - ii, SIMD_WIDTH));
+        if (occludedBlocks(&block, 1, r, tmin, tmax)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+Mesh::intersectBlocks(const TriangleBlock *blocks, int count,
+                      const Ray &r, float tmin, Hit &h) const
 {
-    const Triangle &triangle = _triangles[idx];
-    bool result = triangle.intersect(r, tm, *hit);
+    bool result = false;
+    float t[SIMD_WIDTH], beta[SIMD_WIDTH], gamma[SIMD_WIDTH];
+    for (int ii = 0; ii < count; ii++) {
+        int mask = blocks[ii].intersect(r, tmin, h.getT(), t, beta, gamma);
+        if (!mask) {
+            continue;
+        }
+        int lane = TriangleBlock::closest(mask, t);
+        h.set(t[lane], getMaterial(), normalAt(blocks[ii].index[lane], beta[lane], gamma[lane]));
+        result = true;
+    }
     return result;
 }
+
+bool
+Mesh::intersectBlocks(const TriangleBlock *blocks, int count,
+                      const RayPacket &p, Hit *hits) const
+{
+    // one triangle against all lanes at a time, in block order, so every
+    // lane sees the triangles in the same order as the single-ray path
+    bool result = false;
+    float t[SIMD_WIDTH], beta[SIMD_WIDTH], gamma[SIMD_WIDTH];
+    for (int ii = 0; ii < count; ii++) {
+        const TriangleBlock &block = blocks[ii];
+        for (int lane = 0; lane < SIMD_WIDTH && block.index[lane] >= 0; lane++) {
+            for (int c = 0; c < p.size; c += SIMD_WIDTH) {
+                int mask = block.intersect(lane, p, c, RayPacket::hitDistances(hits, c),
+                                           t, beta, gamma);
+                for (; mask; mask &= mask - 1) {
+                    int i = RayPacket::ctz(mask);
+                    hits[c + i].set(t[i], getMaterial(), normalAt(block.index[lane], beta[i], gamma[i]));
+                    result = true;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+bool
+Mesh::occludedBlocks(const TriangleBlock *blocks, int count,
+                     const Ray &r, float tmin, float tmax) const
+{
+    float t[SIMD_WIDTH], beta[SIMD_WIDTH], gamma[SIMD_WIDTH];
+    for (int ii = 0; ii < count; ii++) {
+        if (blocks[ii].intersect(r, tmin, tmax, t, beta, gamma)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+MeshInstance::intersect(const Ray &r, float tmin, Hit &h) const
+{
+    if (!_mesh->intersect(r, tmin, h)) {
+        return false;
+    }
+    h.material = material;
+    return true;
+}
+
+bool
+MeshInstance::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    // the lanes the mesh moved closer are the ones it hit
+    float t[RayPacket::max_size];
+    for (int i = 0; i < p.count; i++) {
+        t[i] = hits[i].t;
+    }
+    if (!_mesh->intersectPacket(p, hits)) {
+        return false;
+    }
+    for (int i = 0; i < p.count; i++) {
+        if (hits[i].t != t[i]) {
+            hits[i].material = material;
+        }
+    }
+    return true;
+}
@@ -1,32 +1,136 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "Bvh.h"
+#include "MeshCache.h"
 #include "Object3D.h"
-#include "ObjTriangle.h"
 #include "Octree.h"
+#include "TriangleBlock.h"
 #include "Vector2f.h"
 #include "Vector3f.h"
 
+#include <cstdint>
 #include <vector>
 
 class Mesh : public Object3D {
   public:
-    Mesh(const std::string &filename, Material *m);
+    // acceleration structure over the triangles
+    enum Accel {
+        NONE,   // test every triangle
+        OCTREE,
+        BVH,
+    };
+
+    // Maps "none", "octree" or "bvh" to an Accel; false for anything else.
+    static bool parseAccel(const std::string &name, Accel &accel);
+    static const char *accelName(Accel accel);
+
+    // Loads an OBJ file (see ObjFile) on up to `threads` workers, 0 for
+    // all cores. With `cache`, the mesh and its accelerator come from the
+    // file's MeshCache when that is up to date, and are saved there after
+    // a build otherwise.
+    Mesh(const std::string &filename, Material *m, Accel accel = OCTREE, int threads = 0,
+         bool cache = true);
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const;
 
-    virtual bool intersectTrig(int idx, const Ray &r) const;
+    // Packets go down the BVH together; the octree traverses each lane on
+    // its own.
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const;
+
+    virtual bool getBounds(Box &box) const;
+
+    // Closest hit among triangles trigs[0, n), tested SIMD_WIDTH at a time;
+    // updates h.
+    bool intersectTrigs(const int *trigs, int n, const Ray &r, float tmin, Hit &h) const;
+
+    // Is any of triangles trigs[0, n) hit with tmin < t < tmax?
+    bool occludedTrigs(const int *trigs, int n, const Ray &r, float tmin, float tmax) const;
+
+    int triangleCount() const {
+        return (int)(_indices.size() / 3);
+    }
+
+    // corner 0, 1 or 2 of triangle trig
+    const Vector3f &vertex(int trig, int corner) const {
+        return _vertices[_indices[3 * trig + corner]];
+    }
+
+    Box triangleBounds(int trig) const;
+
+  private:
+    // Builds the accelerator and the triangle blocks over the loaded mesh.
+    void buildAccel(int threads);
+
+    // Restores the mesh and accelerator from the cache at path if it
+    // matches header; leaves the mesh empty and returns false otherwise.
+    bool loadCache(const std::string &path, const CacheHeader &header);
+    bool saveCache(const std::string &path, const CacheHeader &header) const;
+
+    // adds the mesh and accelerator sizes to the stats
+    void countMemory() const;
+
+    // Appends triangles trigs[0, n) to blocks, SIMD_WIDTH to a block, and
+    // returns the index of the first block they went into.
+    int packBlocks(const int *trigs, int n, std::vector<TriangleBlock> &blocks) const;
+
+    // Closest hit among the count blocks starting at blocks; updates h.
+    bool intersectBlocks(const TriangleBlock *blocks, int count,
+                         const Ray &r, float tmin, Hit &h) const;
+
+    // The same for every lane of a packet.
+    bool intersectBlocks(const TriangleBlock *blocks, int count,
+                         const RayPacket &p, Hit *hits) const;
+
+    // Is any triangle of the blocks hit with tmin < t < tmax?
+    bool occludedBlocks(const TriangleBlock *blocks, int count,
+                        const Ray &r, float tmin, float tmax) const;
+
+    // Fills _normals with the per vertex average of the adjacent face
+    // normals.
+    void smoothNormals(int threads);
+
+    // interpolated vertex normal of triangle trig at (beta, gamma)
+    Vector3f normalAt(int trig, float beta, float gamma) const;
+
+    std::vector<Vector3f> _vertices;
+    std::vector<Vector3f> _normals;  // from the file, else one per vertex smoothed over the faces
+    std::vector<uint32_t> _indices;  // three vertices per triangle
+    std::vector<uint32_t> _normalIndices; // three normals per triangle; empty
+                                          // when _normals follows _indices
+    Accel _accel;
+    Octree octree;
+    Bvh bvh;
+    // The triangles as blocks: leaf by leaf for the BVH, where _leafBlocks
+    // maps a leaf node to its first block, else in mesh order (the octree
+    // repeats triangles across leaves and gathers them from here).
+    std::vector<TriangleBlock> _blocks;
+    std::vector<int> _leafBlocks;
+};
+
+// A mesh loaded once and placed again with another material: the geometry
+// and the accelerator are the shared mesh's, only the material of the hits
+// is this object's. Placed under Transforms it makes a cheap instance.
+class MeshInstance : public Object3D {
+  public:
+    MeshInstance(const Mesh *mesh, Material *m) : Object3D(m), _mesh(mesh) { }
+
+    virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
+
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override {
+        return _mesh->occluded(r, tmin, tmax);
+    }
 
-    const std::vector<Triangle> & getTriangles() const {
-        return _triangles;
+    virtual bool getBounds(Box &box) const override {
+        return _mesh->getBounds(box);
     }
 
   private:
-    std::vector<Triangle> _triangles;
-    mutable Octree octree;
-    mutable const Ray *ray;
-    mutable Hit *hit;
-    mutable float tm;
+    const Mesh *_mesh;
 };
 
 #endif
@@ -0,0 +1,87 @@
+#include "MeshCache.h"
+
+#include "Parallel.h"
+#include "TriangleBlock.h"
+#include "Vector3f.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+const uint32_t version = 1;
+const size_t hashPiece = 1 << 20;
+
+const uint64_t fnvOffset = 14695981039346656037ULL;
+const uint64_t fnvPrime = 1099511628211ULL;
+
+uint64_t
+fnv1a(const unsigned char *p, size_t n, uint64_t h)
+{
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * fnvPrime;
+    }
+    return h;
+}
+}
+
+CacheHeader::CacheHeader(uint32_t accel, uint64_t objBytes, uint64_t objHash)
+{
+    memset(this, 0, sizeof(CacheHeader));
+    memcpy(magic, "MESHCACH", 8);
+    this->version = ::version;
+    byteOrder = 0x01020304;
+    vectorBytes = sizeof(Vector3f);
+    blockBytes = sizeof(TriangleBlock);
+    this->accel = accel;
+    this->objBytes = objBytes;
+    this->objHash = objHash;
+}
+
+uint64_t
+hashBytes(const char *data, size_t size, int threads)
+{
+    std::vector<uint64_t> pieces((size + hashPiece - 1) / hashPiece);
+    parallelFor((int)pieces.size(), threads, [&](int i) {
+        size_t begin = i * hashPiece;
+        pieces[i] = fnv1a((const unsigned char *)data + begin,
+                          std::min(hashPiece, size - begin), fnvOffset);
+    });
+    uint64_t bytes = size;
+    return fnv1a((const unsigned char *)pieces.data(), pieces.size() * sizeof(uint64_t),
+                 fnv1a((const unsigned char *)&bytes, sizeof(bytes), fnvOffset));
+}
+
+std::string
+cachePath(const std::string &objFile, const std::string &accel)
+{
+    return objFile + "." + accel + ".cache";
+}
+
+bool
+CacheWriter::save(const std::string &path) const
+{
+    std::string tmp = path + ".tmp" + std::to_string((long long)getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(_bytes.data(), 1, _bytes.size(), f) == _bytes.size();
+    ok &= fclose(f) == 0;
+    if (ok && rename(tmp.c_str(), path.c_str()) != 0) {
+        // Windows does not replace an existing file
+        remove(path.c_str());
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(tmp.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,119 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A loaded mesh and its accelerator, saved as <file>.obj.<accel>.cache
+// next to the OBJ file so that the next run can skip parsing and building.
+// The cache starts with a CacheHeader; the owners of the data then write
+// their values and arrays in a fixed order (see Mesh, Octree and Bvh) and
+// read them back in the same order.
+//
+// The header names the OBJ file by size and content hash and records every
+// build parameter a cache depends on: a mismatch anywhere means the cache
+// is stale and the mesh is loaded from the OBJ file again.
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;     // bump when the layout or a build algorithm changes
+    uint32_t byteOrder;   // 0x01020304 as written by this machine
+    uint32_t vectorBytes; // sizeof(Vector3f), 16 with VECMATH_SIMD_STORAGE
+    uint32_t blockBytes;  // sizeof(TriangleBlock), depends on SIMD_WIDTH
+    uint32_t accel;       // Mesh::Accel
+    uint32_t reserved;
+    uint64_t objBytes;
+    uint64_t objHash;
+
+    // header for this build of the renderer
+    CacheHeader(uint32_t accel, uint64_t objBytes, uint64_t objHash);
+
+    bool operator==(const CacheHeader &o) const {
+        return !memcmp(this, &o, sizeof(CacheHeader));
+    }
+};
+
+// 64-bit FNV-1a of the bytes, hashed in parallel 1 MiB pieces whose
+// digests are then hashed in order, so the result does not depend on the
+// thread count.
+uint64_t hashBytes(const char *data, size_t size, int threads);
+
+// Where the cache of an OBJ file with the named accelerator lives.
+std::string cachePath(const std::string &objFile, const std::string &accel);
+
+// Collects a cache in memory; save() writes it out in one go.
+class CacheWriter
+{
+  public:
+    template <typename T>
+    void value(const T &v) {
+        append(&v, sizeof(T));
+    }
+
+    // element count followed by the elements
+    template <typename T>
+    void array(const std::vector<T> &v) {
+        value((uint64_t)v.size());
+        append(v.data(), v.size() * sizeof(T));
+    }
+
+    // Writes to a temporary file and renames it into place, so that
+    // concurrent renders never see half a cache; false on any error.
+    bool save(const std::string &path) const;
+
+  private:
+    void append(const void *p, size_t n) {
+        _bytes.insert(_bytes.end(), (const char *)p, (const char *)p + n);
+    }
+
+    std::vector<char> _bytes;
+};
+
+// Reads values back from a mapped cache. Every read checks the remaining
+// size, so a truncated file fails instead of reading past the mapping.
+class CacheReader
+{
+  public:
+    CacheReader(const char *data, size_t size) :
+        _p(data),
+        _end(data + size)
+    {
+    }
+
+    template <typename T>
+    bool value(T &v) {
+        return take(&v, sizeof(T));
+    }
+
+    template <typename T>
+    bool array(std::vector<T> &v) {
+        uint64_t n;
+        if (!value(n) || n > (uint64_t)(_end - _p) / sizeof(T)) {
+            return false;
+        }
+        v.resize((size_t)n);
+        return take(v.data(), (size_t)n * sizeof(T));
+    }
+
+    // true once everything has been read
+    bool atEnd() const {
+        return _p == _end;
+    }
+
+  private:
+    bool take(void *p, size_t n) {
+        if (n > (size_t)(_end - _p)) {
+            return false;
+        }
+        memcpy(p, _p, n);
+        _p += n;
+        return true;
+    }
+
+    const char *_p, *_end;
+};
+
+#endif // MESH_CACHE_H
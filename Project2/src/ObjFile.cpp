@@ -0,0 +1,342 @@
+#include "ObjFile.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+// The file is parsed in chunks of about this many bytes, cut at line ends:
+// small enough for the workers to balance, large enough to keep the
+// per-chunk bookkeeping negligible.
+const size_t chunkBytes = 256 * 1024;
+
+enum Record { OTHER, VERTEX, NORMAL, TEXCOORD, FACE };
+
+struct Counts
+{
+    size_t vertices, normals, texCoords;
+};
+
+struct Chunk
+{
+    const char *begin, *end;
+
+    // first pass: what the chunk holds
+    size_t lines;
+    Counts count;
+
+    // second pass: records before the chunk, its triangles (indices into
+    // the whole file's lists) and the first malformed line, if any
+    Counts base;
+    std::vector<uint32_t> indices, normalIndices;
+    bool allNormals; // every face named normals
+    const char *error;
+    size_t errorLine;
+};
+
+bool
+isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *
+skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// the newline ending the line at p, or end
+const char *
+lineEnd(const char *p, const char *end)
+{
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+// start of the line after the one ending at eol
+const char *
+nextLine(const char *eol, const char *end)
+{
+    return eol < end ? eol + 1 : end;
+}
+
+// Classifies the line [p, eol) and moves p past the record keyword.
+Record
+recordType(const char *&p, const char *eol)
+{
+    p = skipBlanks(p, eol);
+    size_t n = eol - p;
+    if (n >= 2 && p[0] == 'v' && isBlank(p[1])) {
+        p += 1;
+        return VERTEX;
+    }
+    if (n >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+        p += 2;
+        return NORMAL;
+    }
+    if (n >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+        p += 2;
+        return TEXCOORD;
+    }
+    if (n >= 2 && p[0] == 'f' && isBlank(p[1])) {
+        p += 1;
+        return FACE;
+    }
+    return OTHER;
+}
+
+// Reads a blank-separated float at p. from_chars rounds exactly like the
+// strtof behind stream extraction, so values match the old loader.
+bool
+parseFloat(const char *&p, const char *eol, float &x)
+{
+    p = skipBlanks(p, eol);
+    if (p < eol && *p == '+') {
+        p++; // from_chars takes no plus sign
+    }
+    std::from_chars_result r = std::from_chars(p, eol, x);
+    if (r.ec == std::errc::result_out_of_range) {
+        // let strtof pick zero, a denormal or infinity
+        char token[64];
+        size_t n = std::min((size_t)(r.ptr - p), sizeof(token) - 1);
+        memcpy(token, p, n);
+        token[n] = 0;
+        x = std::strtof(token, nullptr);
+    } else if (r.ec != std::errc()) {
+        return false;
+    }
+    p = r.ptr;
+    return p == eol || isBlank(*p);
+}
+
+bool
+parseVector(const char *&p, const char *eol, Vector3f &v)
+{
+    return parseFloat(p, eol, v[0]) && parseFloat(p, eol, v[1]) && parseFloat(p, eol, v[2]);
+}
+
+// Reads a 1-based index, or a negative one counting back from the `count`
+// entries of its list seen so far, as a 0-based index below total.
+bool
+parseIndex(const char *&p, const char *eol, size_t count, size_t total, uint32_t &index)
+{
+    long long i;
+    std::from_chars_result r = std::from_chars(p, eol, i);
+    if (r.ec != std::errc() || i == 0) {
+        return false;
+    }
+    p = r.ptr;
+    long long resolved = i > 0 ? i - 1 : (long long)count + i;
+    if (resolved < 0 || resolved >= (long long)total || resolved > UINT32_MAX) {
+        return false;
+    }
+    index = (uint32_t)resolved;
+    return true;
+}
+
+void
+countRecords(Chunk &c)
+{
+    c.lines = 0;
+    c.count = Counts{ 0, 0, 0 };
+    for (const char *p = c.begin; p < c.end; c.lines++) {
+        const char *eol = lineEnd(p, c.end);
+        switch (recordType(p, eol)) {
+        case VERTEX:
+            c.count.vertices++;
+            break;
+        case NORMAL:
+            c.count.normals++;
+            break;
+        case TEXCOORD:
+            c.count.texCoords++;
+            break;
+        default:
+            break;
+        }
+        p = nextLine(eol, c.end);
+    }
+}
+
+// Parses the chunk's records into place: vertices and normals go straight
+// into the file-wide arrays at the positions the first pass reserved.
+void
+parseChunk(Chunk &c, const Counts &total, ObjFile &obj)
+{
+    Counts seen = c.base; // records before the current line
+    std::vector<uint32_t> corners, normalCorners;
+    c.allNormals = true;
+    c.error = nullptr;
+    size_t line = 0;
+    for (const char *p = c.begin; p < c.end; line++) {
+        const char *eol = lineEnd(p, c.end);
+        const char *q = p;
+        p = nextLine(eol, c.end);
+
+        switch (recordType(q, eol)) {
+        case VERTEX:
+            if (!parseVector(q, eol, obj.vertices[seen.vertices++])) {
+                c.error = "malformed vertex";
+            }
+            break;
+        case NORMAL: {
+            Vector3f &n = obj.normals[seen.normals++];
+            if (!parseVector(q, eol, n)) {
+                c.error = "malformed normal";
+            } else if (n.absSquared() > 0) {
+                n.normalize();
+            }
+            break;
+        }
+        case TEXCOORD:
+            seen.texCoords++;
+            break;
+        case FACE: {
+            // corners are v, v/vt, v//vn or v/vt/vn
+            corners.clear();
+            normalCorners.clear();
+            bool faceNormals = true;
+            while ((q = skipBlanks(q, eol)) < eol && !c.error) {
+                uint32_t v, vt, vn;
+                bool hasNormal = false;
+                if (!parseIndex(q, eol, seen.vertices, total.vertices, v)) {
+                    c.error = "bad vertex index in face";
+                    break;
+                }
+                if (q < eol && *q == '/') {
+                    q++;
+                    if (q < eol && *q != '/' &&
+                        !parseIndex(q, eol, seen.texCoords, total.texCoords, vt)) {
+                        c.error = "bad texture coordinate index in face";
+                        break;
+                    }
+                    if (q < eol && *q == '/') {
+                        q++;
+                        if (!parseIndex(q, eol, seen.normals, total.normals, vn)) {
+                            c.error = "bad normal index in face";
+                            break;
+                        }
+                        hasNormal = true;
+                    }
+                }
+                if (q < eol && !isBlank(*q)) {
+                    c.error = "malformed face corner";
+                    break;
+                }
+                corners.push_back(v);
+                if (hasNormal) {
+                    normalCorners.push_back(vn);
+                } else {
+                    faceNormals = false;
+                }
+            }
+            if (!c.error && corners.size() < 3) {
+                c.error = "face with fewer than three corners";
+            }
+            if (c.error) {
+                break;
+            }
+            // fan the polygon around its first corner
+            c.allNormals &= faceNormals;
+            for (size_t i = 1; i + 1 < corners.size(); i++) {
+                c.indices.insert(c.indices.end(), { corners[0], corners[i], corners[i + 1] });
+                if (faceNormals) {
+                    c.normalIndices.insert(c.normalIndices.end(),
+                                           { normalCorners[0], normalCorners[i], normalCorners[i + 1] });
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (c.error) {
+            c.errorLine = line;
+            return;
+        }
+    }
+}
+
+}
+
+bool
+ObjFile::read(const char *data, size_t size, const std::string &filename, int threads)
+{
+    const char *end = data + size;
+
+    // cut the file into chunks of whole lines
+    std::vector<Chunk> chunks(std::max<size_t>(1, (size + chunkBytes - 1) / chunkBytes));
+    const char *p = data;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        chunks[i].begin = p;
+        if (i + 1 < chunks.size()) {
+            p = std::max(p, data + size / chunks.size() * (i + 1));
+            p = p < end ? nextLine(lineEnd(p, end), end) : end;
+        } else {
+            p = end;
+        }
+        chunks[i].end = p;
+    }
+
+    // First pass: count the records of each chunk, so that every chunk
+    // knows where its vertices go and what relative indices refer to.
+    parallelFor((int)chunks.size(), threads, [&](int i) {
+        countRecords(chunks[i]);
+    });
+    Counts total = { 0, 0, 0 };
+    for (Chunk &c : chunks) {
+        c.base = total;
+        total.vertices += c.count.vertices;
+        total.normals += c.count.normals;
+        total.texCoords += c.count.texCoords;
+    }
+    vertices.resize(total.vertices);
+    normals.resize(total.normals);
+
+    // Second pass: parse
+    parallelFor((int)chunks.size(), threads, [&](int i) {
+        parseChunk(chunks[i], total, *this);
+    });
+    size_t line = 1, triangleIndices = 0;
+    bool allNormals = true;
+    for (const Chunk &c : chunks) {
+        if (c.error) {
+            std::cout << filename << ":" << line + c.errorLine << ": " << c.error << "\n";
+            return false;
+        }
+        line += c.lines;
+        triangleIndices += c.indices.size();
+        allNormals &= c.allNormals;
+    }
+
+    // Join the chunks' triangles, in file order
+    indices.resize(triangleIndices);
+    if (allNormals && triangleIndices) {
+        normalIndices.resize(triangleIndices);
+    } else {
+        normals = std::vector<Vector3f>();
+    }
+    std::vector<size_t> offset(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        offset[i + 1] = offset[i] + chunks[i].indices.size();
+    }
+    parallelFor((int)chunks.size(), threads, [&](int i) {
+        std::copy(chunks[i].indices.begin(), chunks[i].indices.end(), indices.begin() + offset[i]);
+        if (!normalIndices.empty()) {
+            std::copy(chunks[i].normalIndices.begin(), chunks[i].normalIndices.end(),
+                      normalIndices.begin() + offset[i]);
+        }
+    });
+    return true;
+}
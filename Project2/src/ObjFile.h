@@ -0,0 +1,29 @@
+#ifndef OBJ_FILE_H
+#define OBJ_FILE_H
+
+#include "Vector3f.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Geometry of a Wavefront OBJ file: the `v` and `vn` records and the faces,
+// with polygons fanned into triangles. Texture coordinates are skipped, and
+// normals are only kept if every face names them (else both lists are empty).
+struct ObjFile
+{
+    std::vector<Vector3f> vertices;
+    std::vector<Vector3f> normals;        // vn records, normalized
+    std::vector<uint32_t> indices;        // three vertices per triangle
+    std::vector<uint32_t> normalIndices;  // three normals per triangle
+
+    // Parses the file contents [data, data + size), e.g. a MappedFile, in
+    // chunks of whole lines on up to `threads` workers (see parallelFor).
+    // Indices may be negative (relative to the end of the list so far) and
+    // faces may have any number of corners. Prints the problem, prefixed
+    // with filename and line, and returns false if a record is malformed.
+    bool read(const char *data, size_t size, const std::string &filename, int threads);
+};
+
+#endif // OBJ_FILE_H
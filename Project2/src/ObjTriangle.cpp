@@ -1 +0,0 @@
-#include "ObjTriangle.h"
@@ -1,4 +1,5 @@
 #include "Object3D.h"
+#include "TriangleBlock.h"
 
 static auto dot = Vector3f::dot;
 
@@ -49,6 +50,72 @@ bool Sphere::intersect(const Ray &r, float tmin, Hit &h) const
     return false;
 }
 
+// Sphere::intersect for SIMD_WIDTH lanes at a time, same arithmetic
+bool Sphere::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    const vec3v center = splat(_center);
+    bool result = false;
+    for (int c = 0; c < p.size; c += SIMD_WIDTH)
+    {
+        vec3v dir = p.direction(c);
+        vec3v origin = p.origin(c) - center;
+        vfloat tmin = vfloat::load(p.tmin + c);
+
+        vfloat a = vdot(dir, dir);
+        vfloat b = 2.0f * vdot(dir, origin);
+        vfloat cc = vdot(origin, origin) - _radius * _radius;
+        vfloat disc = b * b - 4.0f * a * cc;
+        vfloat d = vsqrt(disc);
+
+        vfloat tplus = (-b + d) / (2.0f * a);
+        vfloat tminus = (-b - d) / (2.0f * a);
+        vfloat t = select(tminus > tmin, tminus, 10000.0f);
+        t = select((tplus > tmin) & (tminus < tmin), tplus, t);
+
+        vbool hit = andNot(andNot(t < RayPacket::hitDistances(hits, c), disc < 0.0f),
+                           (tplus < tmin) & (tminus < tmin));
+        int bits = movemask(hit);
+        if (!bits)
+            continue;
+
+        float ts[SIMD_WIDTH];
+        t.store(ts);
+        for (; bits; bits &= bits - 1)
+        {
+            int i = RayPacket::ctz(bits), lane = c + i;
+            Vector3f normal = p.ray(lane).pointAtParameter(ts[i]) - _center;
+            normal.normalize();
+            hits[lane].set(ts[i], this->material, normal);
+        }
+        result = true;
+    }
+    return result;
+}
+
+bool Sphere::occluded(const Ray &r, float tmin, float tmax) const
+{
+    const Vector3f &dir = r.getDirection();
+    Vector3f origin = r.getOrigin() - _center;
+
+    float a = dir.absSquared();
+    float b = 2 * dot(dir, origin);
+    float c = origin.absSquared() - _radius * _radius;
+    if (b * b - 4 * a * c < 0)
+        return false;
+
+    float d = sqrt(b * b - 4 * a * c);
+    float tplus = (-b + d) / (2.0f * a);
+    float tminus = (-b - d) / (2.0f * a);
+    return (tminus > tmin && tminus < tmax) || (tplus > tmin && tplus < tmax);
+}
+
+bool Sphere::getBounds(Box &box) const
+{
+    Vector3f r(_radius);
+    box = Box(_center - r, _center + r);
+    return true;
+}
+
 // Add object to group
 void Group::addObject(Object3D *obj)
 {
@@ -63,12 +130,89 @@ int Group::getGroupSize() const
 
 bool Group::intersect(const Ray &r, float tmin, Hit &h) const
 {
+    if (m_bvh.empty() && m_unbounded.empty())
+    {
+        bool hit = false;
+        for (Object3D *o : m_members)
+            hit |= (o->intersect(r, tmin, h));
+        return hit;
+    }
+
+    bool hit = false;
+    for (Object3D *o : m_unbounded)
+        hit |= o->intersect(r, tmin, h);
+    hit |= m_bvh.intersect(r, tmin, h, [&](int i)
+                           { return m_bounded[i]->intersect(r, tmin, h); });
+    return hit;
+}
+
+bool Group::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    if (m_bvh.empty() && m_unbounded.empty())
+    {
+        bool hit = false;
+        for (Object3D *o : m_members)
+            hit |= o->intersectPacket(p, hits);
+        return hit;
+    }
+
     bool hit = false;
-    for (Object3D *o : m_members)
-        hit |= (o->intersect(r, tmin, h));
+    for (Object3D *o : m_unbounded)
+        hit |= o->intersectPacket(p, hits);
+    hit |= m_bvh.intersectPacket(p, hits, [&](int i)
+                                 { return m_bounded[i]->intersectPacket(p, hits); });
     return hit;
 }
 
+bool Group::occluded(const Ray &r, float tmin, float tmax) const
+{
+    if (m_bvh.empty() && m_unbounded.empty())
+    {
+        for (Object3D *o : m_members)
+            if (o->occluded(r, tmin, tmax))
+                return true;
+        return false;
+    }
+
+    for (Object3D *o : m_unbounded)
+        if (o->occluded(r, tmin, tmax))
+            return true;
+    return m_bvh.occluded(r, tmin, tmax, [&](int i)
+                          { return m_bounded[i]->occluded(r, tmin, tmax); });
+}
+
+bool Group::getBounds(Box &box) const
+{
+    box = Box::empty();
+    for (Object3D *o : m_members)
+    {
+        Box b;
+        if (!o->getBounds(b))
+            return false;
+        box.expand(b);
+    }
+    return !m_members.empty();
+}
+
+void Group::buildBvh()
+{
+    m_bounded.clear();
+    m_unbounded.clear();
+    std::vector<Box> bounds;
+    for (Object3D *o : m_members)
+    {
+        Box b;
+        if (o->getBounds(b))
+        {
+            m_bounded.push_back(o);
+            bounds.push_back(b);
+        }
+        else
+            m_unbounded.push_back(o);
+    }
+    m_bvh.build(bounds);
+}
+
 Plane::Plane(const Vector3f &normal, float d, Material *m)
     : Object3D(m), _normal(normal), _d(d) {}
 
@@ -87,6 +231,41 @@ bool Plane::intersect(const Ray &r, float tmin, Hit &h) const
     return true;
 }
 
+bool Plane::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    const vec3v normal = splat(_normal);
+    bool result = false;
+    for (int c = 0; c < p.size; c += SIMD_WIDTH)
+    {
+        vfloat dn = vdot(p.direction(c), normal);
+        vfloat t = (_d - vdot(p.origin(c), normal)) / dn;
+        vbool hit = andNot(!(t < vfloat::load(p.tmin + c)),
+                           (dn == 0.0f) | (RayPacket::hitDistances(hits, c) < t));
+        int bits = movemask(hit);
+        if (!bits)
+            continue;
+
+        float ts[SIMD_WIDTH];
+        t.store(ts);
+        for (; bits; bits &= bits - 1)
+        {
+            int i = RayPacket::ctz(bits);
+            hits[c + i].set(ts[i], material, _normal);
+        }
+        result = true;
+    }
+    return result;
+}
+
+bool Plane::occluded(const Ray &r, float tmin, float tmax) const
+{
+    float dn = dot(r.getDirection(), _normal);
+    if (dn == 0)
+        return false;
+    float t = (_d - dot(r.getOrigin(), _normal)) / dn;
+    return t >= tmin && t < tmax;
+}
+
 static auto cross = Vector3f::cross;
 
 bool Triangle::intersect(const Ray &r, float tmin, Hit &h) const
@@ -105,32 +284,126 @@ bool Triangle::intersect(const Ray &r, float tmin, Hit &h) const
     if (!(beta > 0 && gamma > 0 && (1 - beta - gamma > 0) && t > tmin && t < h.getT()))
         return false;
 
-    h.set(t, material, ((1 - beta - gamma) * _normals[0] + beta * _normals[1] + gamma * _normals[2]).normalized());
+    h.set(t, material, normalAt(beta, gamma));
     return true;
 }
 
-Transform::Transform(const Matrix4f &m, Object3D *obj)
-    : _object(obj), _m(m), _inv(m.inverse()) {}
+bool Triangle::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    // the same Cramer's rule as intersect(), one triangle against the lanes
+    const vec3v a = splat(_v[0]), ba = splat(_v[1] - _v[0]), ca = splat(_v[2] - _v[0]);
+    bool result = false;
+    for (int c = 0; c < p.size; c += SIMD_WIDTH)
+    {
+        vfloat t, beta, gamma;
+        vbool hit = intersectTriangles(a, ba, ca, p.origin(c), p.direction(c),
+                                       vfloat::load(p.tmin + c), RayPacket::hitDistances(hits, c),
+                                       t, beta, gamma);
+        int bits = movemask(hit);
+        if (!bits)
+            continue;
+
+        float ts[SIMD_WIDTH], bs[SIMD_WIDTH], gs[SIMD_WIDTH];
+        t.store(ts);
+        beta.store(bs);
+        gamma.store(gs);
+        for (; bits; bits &= bits - 1)
+        {
+            int i = RayPacket::ctz(bits);
+            hits[c + i].set(ts[i], material, normalAt(bs[i], gs[i]));
+        }
+        result = true;
+    }
+    return result;
+}
 
-static Vector3f trn(Matrix4f m, Vector3f v, float w)
+bool Triangle::occluded(const Ray &r, float tmin, float tmax) const
 {
-    return (m * Vector4f(v, w)).xyz();
+    const Vector3f &origin = r.getOrigin(), &direction = r.getDirection();
+    const Vector3f &a = _v[0], &b = _v[1], &c = _v[2];
+
+    Vector3f pvec = cross(direction, c - a);
+    float dno = dot(pvec, b - a);
+    Vector3f num = cross(origin - a, b - a);
+
+    float t = (dot(num, c - a)) / dno;
+    float beta = (dot(pvec, origin - a)) / dno;
+    float gamma = (dot(num, direction)) / dno;
+    return beta > 0 && gamma > 0 && (1 - beta - gamma > 0) && t > tmin && t < tmax;
 }
 
-bool Transform::intersect(const Ray &r, float tmin, Hit &h) const
+bool Triangle::getBounds(Box &box) const
 {
-    Ray tr(trn(_inv, r.getOrigin(), 1),
-           trn(_inv, r.getDirection(), 0).normalized());
-    Hit th;
-    tmin = (trn(_inv, r.pointAtParameter(tmin), 1) - tr.getOrigin()).abs();
+    box = Box(_v[0], _v[0]);
+    box.expand(_v[1]);
+    box.expand(_v[2]);
+    return true;
+}
 
+Transform::Transform(const Matrix4f &m, Object3D *obj)
+    : _object(obj), _m(m), _inv(m.inverse()) {}
+
+bool Transform::intersect(const Ray &r, float tmin, Hit &h) const
+{
+    // t carries over unchanged, so the object only looks for hits closer
+    // than h
+    Ray tr(_inv.point(r.getOrigin()), _inv.vector(r.getDirection()));
+    Hit th(h.getT(), NULL, Vector3f());
     if (!_object->intersect(tr, tmin, th))
         return false;
 
-    float t = (trn(_m, tr.pointAtParameter(th.getT()), 1) - r.getOrigin()).abs();
-    if (t < tmin || t > h.getT())
+    h.set(th.getT(), th.getMaterial(), _inv.transposedVector(th.getNormal()).normalized());
+    return true;
+}
+
+bool Transform::intersectPacket(const RayPacket &p, Hit *hits) const
+{
+    // Per lane this is intersect(); the lanes the object moved closer are
+    // the ones it hit.
+    RayPacket tp;
+    Hit th[RayPacket::max_size];
+    for (int i = 0; i < p.count; ++i)
+    {
+        Ray r = p.ray(i);
+        tp.set(i, Ray(_inv.point(r.getOrigin()), _inv.vector(r.getDirection())), p.tmin[i]);
+        th[i].t = hits[i].getT();
+    }
+    tp.finish(p.count);
+
+    if (!_object->intersectPacket(tp, th))
         return false;
 
-    h.set(t, th.getMaterial(), trn(_inv.transposed(), th.getNormal(), 0).normalized());
+    bool result = false;
+    for (int i = 0; i < p.count; ++i)
+    {
+        if (th[i].getT() == hits[i].getT())
+            continue;
+        hits[i].set(th[i].getT(), th[i].getMaterial(),
+                    _inv.transposedVector(th[i].getNormal()).normalized());
+        result = true;
+    }
+    return result;
+}
+
+bool Transform::occluded(const Ray &r, float tmin, float tmax) const
+{
+    Ray tr(_inv.point(r.getOrigin()), _inv.vector(r.getDirection()));
+    return _object->occluded(tr, tmin, tmax);
+}
+
+bool Transform::getBounds(Box &box) const
+{
+    Box ob;
+    if (!_object->getBounds(ob))
+        return false;
+    // bound the eight transformed corners
+    box = Box::empty();
+    for (int i = 0; i < 8; ++i)
+    {
+        Vector3f corner(i & 4 ? ob.mx[0] : ob.mn[0],
+                        i & 2 ? ob.mx[1] : ob.mn[1],
+                        i & 1 ? ob.mx[2] : ob.mn[2]);
+        box.expand(_m.point(corner));
+    }
     return true;
 }
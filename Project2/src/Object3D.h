@@ -1,10 +1,15 @@
 #ifndef OBJECT3D_H
 #define OBJECT3D_H
 
+#include "Affine.h"
+#include "Box.h"
+#include "Bvh.h"
 #include "Ray.h"
+#include "RayPacket.h"
 #include "Material.h"
 
 #include <string>
+#include <vector>
 
 class Object3D
 {
@@ -30,6 +35,31 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const = 0;
 
+    // Closest hit for each ray of a packet, hits[i] belonging to lane i;
+    // returns true if any lane got closer. The default traces the lanes one
+    // by one, so only objects with a vectorized test need to override it.
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const {
+        bool hit = false;
+        for (int i = 0; i < p.count; ++i) {
+            hit |= intersect(p.ray(i), p.tmin[i], hits[i]);
+        }
+        return hit;
+    }
+
+    // Any-hit query for shadow rays: is anything hit with tmin < t < tmax?
+    // Unlike intersect() this may stop at the first blocker it finds.
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const {
+        Hit h;
+        h.t = tmax;
+        return intersect(r, tmin, h);
+    }
+
+    // World space bounding box. Returns false for unbounded objects
+    // (e.g. planes), which acceleration structures keep on the side.
+    virtual bool getBounds(Box &) const {
+        return false;
+    }
+
     std::string   type;
     Material*     material;
 };
@@ -55,6 +85,12 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override;
+
+    virtual bool getBounds(Box &box) const override;
+
 private:
     Vector3f _center;
     float    _radius;
@@ -66,13 +102,26 @@ public:
     // Return true if intersection found
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override;
+
+    virtual bool getBounds(Box &box) const override;
+
     // Add object to group
     void addObject(Object3D *obj);
 
     // Return number of objects in group
     int getGroupSize() const;
+
+    // Builds the BVH over the bounded members; call once all objects have
+    // been added. Until then intersect() tests every member in turn.
+    void buildBvh();
 private:
     std::vector<Object3D*> m_members;
+    Bvh m_bvh;                       // over m_bounded
+    std::vector<Object3D*> m_bounded;
+    std::vector<Object3D*> m_unbounded;
 };
 
 
@@ -83,14 +132,16 @@ public:
 
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override;
+
 // private:
     Vector3f _normal;
     float _d;
 };
 
 
-// do not remove getVertex and getNormal
-// as they are currently called by the Octree for optimization
 class Triangle : public Object3D
 {
 public:
@@ -113,6 +164,12 @@ public:
 
     virtual bool intersect(const Ray &ray, float tmin, Hit &hit) const override;
 
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &ray, float tmin, float tmax) const override;
+
+    virtual bool getBounds(Box &box) const override;
+
     const Vector3f & getVertex(int index) const {
         assert(index < 3);
         return _v[index];
@@ -123,21 +180,42 @@ public:
         return _normals[index];
     }
 
+    // interpolated vertex normal at barycentric coordinates (beta, gamma)
+    Vector3f normalAt(float beta, float gamma) const {
+        return ((1 - beta - gamma) * _normals[0] + beta * _normals[1] + gamma * _normals[2]).normalized();
+    }
+
 private:
     Vector3f _v[3];
     Vector3f _normals[3];
 };
 
 
+// Places an object with an affine matrix. Rays go into object space
+// without renormalizing their direction, so a hit's t is the same in both
+// spaces and needs no conversion.
 class Transform : public Object3D
 {
 public:
     Transform(const Matrix4f &m, Object3D *obj);
 
+    Matrix4f getMatrix() const {
+        return _m.toMatrix4f();
+    }
+    Object3D *getObject() const {
+        return _object;
+    }
+
     virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
 
+    virtual bool intersectPacket(const RayPacket &p, Hit *hits) const override;
+
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override;
+
+    virtual bool getBounds(Box &box) const override;
+
 private:
-    Matrix4f _m, _inv;
+    Affine _m, _inv;
     Object3D *_object; //un-transformed object  
 };
 
@@ -1,95 +1,74 @@
 #include "Ray.h"
 #include "Vector3f.h"
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "Octree.h"
+#include "Parallel.h"
+#include "Stats.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
-///@brief two intervals intersect
-bool
-intersect(float *a, float *b)
+namespace
 {
-    if (a[0] > b[1]) {
-        return a[0] <= b[1];
-    } else {
-        return b[0] <= a[1];
-    }
-}
-
-///@brief two boxes intersect
-bool
-boxOverlap(Box *a, Box *b)
+// Which of the eight children of pbox each triangle overlaps: bit ii of
+// the result stands for child ii. Child ii takes the upper half of x, y
+// and z where bit 4, 2 and 1 of ii is set, halves meeting at the middle.
+// A triangle belongs to every child whose closed box its bounds touch.
+uint8_t
+childMask(const Box &tBox, const Box &pbox, const Vector3f &mid)
 {
+    int lo = 0, hi = 0;
     for (int dim = 0; dim < 3; dim++) {
-        float ia[2] = { a->mn[dim], a->mx[dim] };
-        float ib[2] = { b->mn[dim], b->mx[dim] };
-        bool inter = intersect(ia, ib);
-        if (!inter) {
-            return false;
+        int bit = 4 >> dim;
+        if (!(tBox.mn[dim] > mid[dim]) && pbox.mn[dim] <= tBox.mx[dim]) {
+            lo |= bit;
+        }
+        if (!(tBox.mn[dim] > pbox.mx[dim]) && mid[dim] <= tBox.mx[dim]) {
+            hi |= bit;
         }
     }
-    return true;
-}
-
-bool
-inside(const Box &a, const Box &b)
-{
-    for (int dim = 0; dim < 3; dim++) {
-        if (a.mn[dim] < b.mn[dim] || a.mx[dim] > b.mx[dim]) {
-            return false;
+    uint8_t mask = 0;
+    for (int ii = 0; ii < 8; ii++) {
+        if (((ii & hi) | (~ii & lo)) == 7) {
+            mask |= 1 << ii;
         }
     }
-    return true;
+    return mask;
 }
 
-///@brief bounding box for a triangle
-Box
-trigBox(int t, const Mesh &m)
-{
-    const auto &tri = m.getTriangles();
-
-    Box b;
-    b.mn = tri[t].getVertex(0);
-    b.mx = tri[t].getVertex(0);
-
-    for (int ii = 1; ii< 3; ii++) {
-        for (int dim = 0; dim < 3; dim++) {
-            if (b.mn[dim] > tri[t].getVertex(ii)[dim]) {
-                b.mn[dim] = tri[t].getVertex(ii)[dim];
-            }
-            if (b.mx[dim] < tri[t].getVertex(ii)[dim]) {
-                b.mx[dim] = tri[t].getVertex(ii)[dim];
-            }
-        }
-    }
-    return b;
+// Subtrees at this depth are built as parallel tasks: up to 64 of them,
+// enough for the work stealing in parallelFor to even out empty and
+// crowded parts of the mesh.
+const int task_depth = 2;
 }
 
-///@brief pbox parent's box
-void
-Octree::buildNode(OctNode *parent,
-                  const Box &pbox,
-                  const std::vector<int> &trigs,
-                  const Mesh &m,
-                  int level)
+// One subtree being built on its own: node and triangle slots are local
+// to it until build() moves it into the tree.
+struct Octree::Subtree
 {
-    if (trigs.size() <= Octree::max_trig || level > maxLevel) {
-        parent->obj = trigs;
-        return;
-    }
-
-    level++;
-
-    // Initialize 8 children
-    for (int ii = 0; ii < 8; ii++) {
-        parent->child[ii] = new OctNode();
-    }
+    const std::vector<Box> *bounds;
+    std::vector<OctGroup> groups;
+    std::vector<int> trigs;
+    // per level: the triangles of the children of the node being split
+    std::vector<std::vector<int>> lists;
+    std::vector<uint8_t> masks;
+    OctNode root;
+};
 
+void
+Octree::split(const Box &pbox, const int *nodeTrigs, int n,
+              const std::vector<Box> &bounds, std::vector<uint8_t> &masks,
+              Box cBox[8], std::vector<int> &childTrigs, int start[9])
+{
     const Vector3f &mn = pbox.mn;
     const Vector3f &mx = pbox.mx;
     Vector3f mid = (mn + mx) / 2.0;
 
-    Box cBox[8];
     cBox[0] = Box(mn, mid);
     cBox[1] = Box( mn[0],  mn[1], mid[2], mid[0], mid[1],  mx[2]);
     cBox[2] = Box( mn[0], mid[1],  mn[2], mid[0],  mx[1], mid[2]);
@@ -99,50 +78,240 @@ Octree::buildNode(OctNode *parent,
     cBox[6] = Box(mid[0], mid[1],  mn[2],  mx[0],  mx[1], mid[2]);
     cBox[7] = Box(mid[0], mid[1], mid[2],  mx[0],  mx[1],  mx[2]);
 
+    // one pass to count, one to scatter; each child keeps the node's order
+    int count[8] = {};
+    masks.resize(n);
+    for (int vi = 0; vi < n; vi++) {
+        uint8_t mask = childMask(bounds[nodeTrigs[vi]], pbox, mid);
+        masks[vi] = mask;
+        for (int ii = 0; ii < 8; ii++) {
+            count[ii] += (mask >> ii) & 1;
+        }
+    }
+    start[0] = 0;
     for (int ii = 0; ii < 8; ii++) {
-        std::vector<int> childTrigs;
-        for (unsigned int vi = 0; vi < trigs.size(); vi++) {
-            int trigIdx = trigs[vi];
-            Box tBox = trigBox(trigIdx, m);
-            if (inside(tBox, cBox[ii]) || boxOverlap(&tBox, &(cBox[ii]))) {
-                childTrigs.push_back(trigIdx);
+        start[ii + 1] = start[ii] + count[ii];
+    }
+    childTrigs.resize(start[8]);
+    int fill[8];
+    std::copy(start, start + 8, fill);
+    for (int vi = 0; vi < n; vi++) {
+        for (int ii = 0; ii < 8; ii++) {
+            if ((masks[vi] >> ii) & 1) {
+                childTrigs[fill[ii]++] = nodeTrigs[vi];
             }
         }
-        buildNode(parent->child[ii], cBox[ii], childTrigs, m, level);
     }
 }
 
+///@brief pbox node's box
+OctNode
+Octree::buildNode(const Box &pbox,
+                  const int *nodeTrigs, int n,
+                  int level,
+                  Subtree &out) const
+{
+    OctNode node;
+    if (n <= Octree::max_trig || level > maxLevel) {
+        node.first = (int)out.trigs.size();
+        node.count = n;
+        out.trigs.insert(out.trigs.end(), nodeTrigs, nodeTrigs + n);
+        return node;
+    }
+
+    level++;
+
+    // reserve the 8 children as one group; they are filled in below
+    int group = (int)out.groups.size();
+    out.groups.emplace_back();
+    node.first = group;
+    node.count = -1;
+
+    // the children's lists live in this level's buffer, which deeper
+    // levels leave alone
+    Box cBox[8];
+    int start[9];
+    std::vector<int> &childTrigs = out.lists[level];
+    split(pbox, nodeTrigs, n, *out.bounds, out.masks, cBox, childTrigs, start);
+    for (int ii = 0; ii < 8; ii++) {
+        // groups may reallocate while the child is built: assign afterwards
+        OctNode child = buildNode(cBox[ii], childTrigs.data() + start[ii],
+                                  start[ii + 1] - start[ii], level, out);
+        out.groups[group].child[ii] = child;
+    }
+    return node;
+}
+
 void
-Octree::build(Mesh *m)
+Octree::build(const Mesh *m, int threads)
 {
     mesh = m;
+    assert(maxLevel < max_depth);
 
-    const auto &tri = mesh->getTriangles();
-    assert(!tri.empty());
-
-    // compute bounding box for m
-    box.mn = tri[0].getVertex(0);
-    box.mx = tri[0].getVertex(0);
-    for (unsigned int ii = 0; ii < tri.size(); ii++) {
-        const auto &t = tri[ii];
-        for (int vi = 0; vi < 3; ++vi) {
-            const auto &v = t.getVertex(vi);
-            for (int dim = 0; dim < 3; dim++) {
-                if (box.mn[dim] > v[dim]) {
-                    box.mn[dim] = v[dim];
-                }
-                if (box.mx[dim] < v[dim]) {
-                    box.mx[dim] = v[dim];
-                }
-            }
+    int count = mesh->triangleCount();
+    assert(count > 0);
+
+    // every triangle's bounds, computed once for all levels
+    std::vector<Box> bounds(count);
+    parallelRanges(count, 16384, threads, [&](size_t begin, size_t end) {
+        for (size_t ii = begin; ii < end; ii++) {
+            bounds[ii] = mesh->triangleBounds((int)ii);
+        }
+    });
+    box = bounds[0];
+    for (int ii = 1; ii < count; ii++) {
+        box.expand(bounds[ii]);
+    }
+
+    // Split the top task_depth levels here; everything below becomes a
+    // task. A plan node is either a task or an inner node whose children
+    // are plan nodes.
+    struct PlanNode
+    {
+        int task;     // -1 for an inner node
+        int child[8];
+        int group;    // inner: its group in the finished tree
+    };
+    struct Task
+    {
+        Box box;
+        std::vector<int> trigs;
+        int level;
+        Subtree tree;
+    };
+    std::vector<PlanNode> plan;
+    std::vector<Task> tasks;
+    std::function<int(const Box &, std::vector<int> &, int)> expand =
+        [&](const Box &pbox, std::vector<int> &nodeTrigs, int level) {
+        int index = (int)plan.size();
+        plan.push_back(PlanNode());
+        int n = (int)nodeTrigs.size();
+        if (level >= task_depth || n <= Octree::max_trig || level > maxLevel) {
+            plan[index].task = (int)tasks.size();
+            tasks.push_back({ pbox, std::move(nodeTrigs), level, Subtree() });
+            return index;
+        }
+        plan[index].task = -1;
+        Box cBox[8];
+        int start[9];
+        std::vector<int> childTrigs;
+        std::vector<uint8_t> masks;
+        split(pbox, nodeTrigs.data(), n, bounds, masks, cBox, childTrigs, start);
+        for (int ii = 0; ii < 8; ii++) {
+            std::vector<int> list(childTrigs.begin() + start[ii], childTrigs.begin() + start[ii + 1]);
+            int child = expand(cBox[ii], list, level + 1);
+            plan[index].child[ii] = child;
         }
+        return index;
+    };
+    std::vector<int> all(count);
+    for (int ii = 0; ii < count; ii++) {
+        all[ii] = ii;
     }
+    expand(box, all, 0);
 
-    std::vector<int> trigs(tri.size());
-    for (unsigned int ii = 0; ii < trigs.size(); ii++) {
-        trigs[ii] = ii;
+    parallelFor((int)tasks.size(), threads, [&](int t) {
+        Task &task = tasks[t];
+        Subtree &tree = task.tree;
+        tree.bounds = &bounds;
+        tree.lists.resize(maxLevel + 2);
+        tree.root = buildNode(task.box, task.trigs.data(), (int)task.trigs.size(), task.level, tree);
+        task.trigs = std::vector<int>();
+        tree.lists = std::vector<std::vector<int>>();
+        tree.masks = std::vector<uint8_t>();
+        tree.groups.shrink_to_fit();
+        tree.trigs.shrink_to_fit();
+    });
+    bounds = std::vector<Box>();
+
+    // Lay the tree out exactly as a depth-first serial build would: an
+    // inner node's group, then its children's subtrees in order. The
+    // tasks are then copied into their slots in parallel.
+    std::vector<size_t> groupBase(tasks.size()), trigBase(tasks.size());
+    size_t groupCount = 0, trigCount = 0;
+    std::function<void(int)> place = [&](int index) {
+        PlanNode &p = plan[index];
+        if (p.task >= 0) {
+            groupBase[p.task] = groupCount;
+            trigBase[p.task] = trigCount;
+            groupCount += tasks[p.task].tree.groups.size();
+            trigCount += tasks[p.task].tree.trigs.size();
+            return;
+        }
+        p.group = (int)groupCount++;
+        for (int ii = 0; ii < 8; ii++) {
+            place(p.child[ii]);
+        }
+    };
+    place(0);
+
+    // a task's node with its slots moved to where the task landed
+    auto moved = [&](int t, OctNode node) {
+        node.first += (int)(node.isTerm() ? trigBase[t] : groupBase[t]);
+        return node;
+    };
+    groups.assign(groupCount, OctGroup());
+    trigs.assign(trigCount, 0);
+    std::vector<int> inner;
+    for (size_t ii = 0; ii < plan.size(); ii++) {
+        if (plan[ii].task < 0) {
+            inner.push_back((int)ii);
+        }
     }
-    buildNode(&root, box, trigs, *mesh, 0);
+    auto planNode = [&](int index) {
+        const PlanNode &p = plan[index];
+        if (p.task >= 0) {
+            return moved(p.task, tasks[p.task].tree.root);
+        }
+        OctNode node;
+        node.first = p.group;
+        node.count = -1;
+        return node;
+    };
+    for (int ii : inner) {
+        for (int c = 0; c < 8; c++) {
+            groups[plan[ii].group].child[c] = planNode(plan[ii].child[c]);
+        }
+    }
+    parallelFor((int)tasks.size(), threads, [&](int t) {
+        const Subtree &tree = tasks[t].tree;
+        for (size_t g = 0; g < tree.groups.size(); g++) {
+            for (int c = 0; c < 8; c++) {
+                groups[groupBase[t] + g].child[c] = moved(t, tree.groups[g].child[c]);
+            }
+        }
+        std::copy(tree.trigs.begin(), tree.trigs.end(), trigs.begin() + trigBase[t]);
+        tasks[t].tree = Subtree();
+    });
+    root = planNode(0);
+}
+
+void
+Octree::save(CacheWriter &out) const
+{
+    out.value((int32_t)maxLevel);
+    out.value((int32_t)max_trig);
+    out.value(box);
+    out.value(root);
+    out.array(groups);
+    out.array(trigs);
+}
+
+bool
+Octree::load(CacheReader &in, const Mesh *m)
+{
+    int32_t level, trig;
+    if (!in.value(level) || !in.value(trig) || level != maxLevel || trig != max_trig) {
+        return false;
+    }
+    mesh = m;
+    return in.value(box) && in.value(root) && in.array(groups) && in.array(trigs);
+}
+
+size_t
+Octree::memoryUsage() const
+{
+    return groups.capacity() * sizeof(OctGroup) + trigs.capacity() * sizeof(int);
 }
 
 int
@@ -205,112 +374,158 @@ Octree::proc_subtree(float tx0,
                      float tx1, 
                      float ty1, 
                      float tz1, 
-                     OctNode *node,
-                     const Ray &ray)
+                     const OctNode *root,
+                     Traversal &tr) const
 {
+    // Revelles et al. traversal with an explicit stack instead of recursion.
+    // Each frame is an inner node whose children are visited in ray order;
+    // currNode is the next child to enter (8 once all of them are done).
+    struct Frame
+    {
+        const OctNode *node;
+        float tx0, ty0, tz0, tx1, ty1, tz1;
+        float txm, tym, tzm;
+        int currNode;
+    };
+    Frame stack[max_depth];
+    int top = 0;
     bool intersected = false;
 
-    if (tx1 < 0 || ty1 < 0 || tz1 < 0) {
-        return intersected;
-    }
+    auto enter = [&](float tx0, float ty0, float tz0,
+                     float tx1, float ty1, float tz1,
+                     const OctNode *node)
+    {
+        tr.nodeVisits++;
+        if (tx1 < 0 || ty1 < 0 || tz1 < 0) {
+            return;
+        }
+        if (node->isTerm()) {
+            const int *leaf = trigs.data() + node->first;
+            tr.triangleTests += node->count;
+            if (tr.hit) {
+                bool result = mesh->intersectTrigs(leaf, node->count, tr.ray, tr.tmin, *tr.hit);
+                intersected = intersected || result;
+            } else if (mesh->occludedTrigs(leaf, node->count, tr.ray, tr.tmin, tr.tmax)) {
+                // any blocker answers an occlusion query: unwind
+                intersected = true;
+                top = 0;
+            }
+            return;
+        }
+        float txm = 0.5f * (tx0 + tx1);
+        float tym = 0.5f * (ty0 + ty1);
+        float tzm = 0.5f * (tz0 + tz1);
+        Frame &f = stack[top++];
+        f.node = node;
+        f.tx0 = tx0; f.ty0 = ty0; f.tz0 = tz0;
+        f.tx1 = tx1; f.ty1 = ty1; f.tz1 = tz1;
+        f.txm = txm; f.tym = tym; f.tzm = tzm;
+        f.currNode = first_node(tx0, ty0, tz0, txm, tym, tzm);
+    };
 
-    if (node->isTerm()) {
-        //loop over things
-        for (size_t ii = 0; ii < node->obj.size(); ii++) {
-            bool result = mesh->intersectTrig(node->obj[ii],ray);
-            intersected = intersected || result;
+    enter(tx0, ty0, tz0, tx1, ty1, tz1, root);
+    while (top > 0) {
+        Frame &f = stack[top - 1];
+        float cx0, cy0, cz0, cx1, cy1, cz1;
+        int next;
+        switch (f.currNode) {
+        case 0:
+            cx0 = f.tx0; cy0 = f.ty0; cz0 = f.tz0; cx1 = f.txm; cy1 = f.tym; cz1 = f.tzm;
+            next = new_node(f.txm, 4, f.tym, 2, f.tzm, 1);
+            break;
+        case 1:
+            cx0 = f.tx0; cy0 = f.ty0; cz0 = f.tzm; cx1 = f.txm; cy1 = f.tym; cz1 = f.tz1;
+            next = new_node(f.txm, 5, f.tym, 3, f.tz1, 8);
+            break;
+        case 2:
+            cx0 = f.tx0; cy0 = f.tym; cz0 = f.tz0; cx1 = f.txm; cy1 = f.ty1; cz1 = f.tzm;
+            next = new_node(f.txm, 6, f.ty1, 8, f.tzm, 3);
+            break;
+        case 3:
+            cx0 = f.tx0; cy0 = f.tym; cz0 = f.tzm; cx1 = f.txm; cy1 = f.ty1; cz1 = f.tz1;
+            next = new_node(f.txm, 7, f.ty1, 8, f.tz1, 8);
+            break;
+        case 4:
+            cx0 = f.txm; cy0 = f.ty0; cz0 = f.tz0; cx1 = f.tx1; cy1 = f.tym; cz1 = f.tzm;
+            next = new_node(f.tx1, 8, f.tym, 6, f.tzm, 5);
+            break;
+        case 5:
+            cx0 = f.txm; cy0 = f.ty0; cz0 = f.tzm; cx1 = f.tx1; cy1 = f.tym; cz1 = f.tz1;
+            next = new_node(f.tx1, 8, f.tym, 7, f.tz1, 8);
+            break;
+        case 6:
+            cx0 = f.txm; cy0 = f.tym; cz0 = f.tz0; cx1 = f.tx1; cy1 = f.ty1; cz1 = f.tzm;
+            next = new_node(f.tx1, 8, f.ty1, 8, f.tzm, 7);
+            break;
+        case 7:
+            cx0 = f.txm; cy0 = f.tym; cz0 = f.tzm; cx1 = f.tx1; cy1 = f.ty1; cz1 = f.tz1;
+            next = 8;
+            break;
+        default:
+            top--;
+            continue;
         }
-        return intersected;
-    }
 
-    float txm = 0.5f * (tx0 + tx1);
-    float tym = 0.5f * (ty0 + ty1);  
-    float tzm = 0.5f * (tz0 + tz1);  
-    int currNode = first_node(tx0, ty0, tz0, txm, tym, tzm);
-    do {
-        switch (currNode) {
-        case 0: {
-            bool result = proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 4, tym, 2, tzm, 1);
-        } break;
-        case 1: {
-            bool result = proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 5, tym, 3, tz1, 8);
-        } break;
-        case 2: {
-            bool result = proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 6, ty1, 8, tzm, 3);
-        } break;
-        case 3: {
-            bool result = proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 7, ty1, 8, tz1, 8);
-        } break;
-        case 4: {
-            bool result = proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, tym, 6, tzm, 5);
-        } break;
-        case 5: {
-            bool result = proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, tym, 7, tz1, 8);
-        } break;
-        case 6: {
-            bool result = proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, ty1, 8, tzm, 7);
-        } break;
-        case 7: {
-            bool result = proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7^aa],ray);
-            intersected |= result;
-            currNode = 8;
-        } break;
+        // Children are entered in increasing entry t, and the remaining
+        // children of every ancestor start even later. Once the closest hit
+        // lies before this child's entry point nothing left can beat it.
+        if (tr.limit() < std::max(std::max(cx0, cy0), cz0)) {
+            break;
         }
-    } while (currNode < 8);
+
+        const OctNode *child = &groups[f.node->first].child[f.currNode ^ tr.aa];
+        f.currNode = next;
+        enter(cx0, cy0, cz0, cx1, cy1, cz1, child);
+    }
 
     return intersected;
 }
 
 bool
-Octree::intersect(const Ray &ray)
+Octree::intersect(const Ray &ray, float tmin, Hit &h) const
+{
+    Traversal tr = { ray, tmin, &h, 0, 0, 0, 0 };
+    return traverse(tr);
+}
+
+bool
+Octree::occluded(const Ray &ray, float tmin, float tmax) const
+{
+    Traversal tr = { ray, tmin, nullptr, tmax, 0, 0, 0 };
+    return traverse(tr);
+}
+
+bool
+Octree::traverse(Traversal &tr) const
 {
-    Vector3f rd = ray.getDirection();
+    const Ray &ray = tr.ray;
 
-    //assumes rd normalized
-    rd.normalize();
+    // The ray is mirrored into the all-positive octant (aa remembers which
+    // axes were flipped). rd is deliberately left unnormalized: the slab
+    // distances are then in units of the ray parameter, so they compare
+    // directly against hit t.
     Vector3f ro = ray.getOrigin();
+    const Vector3f &inv = ray.getInvDirection();
 
-    aa = 0;
+    uint8_t &aa = tr.aa;
     Vector3f size = box.mx + box.mn;
-    if (rd[0]<0.0f) {
+    if (ray.getSign(0)) {
         ro[0] = size[0] - ro[0];
-        rd[0] = - rd[0];
         aa |= 4 ; 
     }
-    if (rd[1] < 0.0f) {
+    if (ray.getSign(1)) {
         ro[1] = size[1] - ro[1];
-        rd[1] = - rd[1];
         aa |= 2 ;
     }
-    if (rd[2] < 0.0f) {
+    if (ray.getSign(2)) {
         ro[2] = size[2] - ro[2];
-        rd[2] = - rd[2];
         aa |= 1 ;
     }
 
-#if 0
-    float divx = 1 / (0.000001f+rd[0]); // IEEE stability fix
-    float divy = 1 / (0.000001f+rd[1]);
-    float divz = 1 / (0.000001f+rd[2]);
-#else
-    float divx = 1 / rd[0]; // IEEE stability fix
-    float divy = 1 / rd[1];
-    float divz = 1 / rd[2];
-#endif
+    // 1 / -rd == -(1 / rd), so the mirrored reciprocal is just |inv|
+    float divx = std::abs(inv[0]);
+    float divy = std::abs(inv[1]);
+    float divz = std::abs(inv[2]);
 
     float tx0 = (box.mn[0] - ro[0]) * divx;
     float tx1 = (box.mx[0] - ro[0]) * divx;
@@ -320,7 +535,11 @@ Octree::intersect(const Ray &ray)
     float tz1 = (box.mx[2] - ro[2]) * divz;
 
     if (std::max(std::max(tx0,ty0), tz0) <= std::min(std::min(tx1, ty1), tz1)) {
-        return proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, ray);
+        bool result = proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, tr);
+        TraceStats &stats = Stats::local();
+        stats.nodeVisits += tr.nodeVisits;
+        stats.triangleTests += tr.triangleTests;
+        return result;
     } else {
         return false;
     }
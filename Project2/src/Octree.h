@@ -1,47 +1,37 @@
 #ifndef OCTREE_HPP
 #define OCTREE_HPP
 
-class Mesh;
-
-struct Box
-{
-    Vector3f mn, mx;
+#include "Box.h"
 
-    Box() {}
+#include <cstdint>
+#include <vector>
 
-    Box(const Vector3f &a, const Vector3f &b) :
-        mn(a),
-        mx(b)
-    {}
-
-    Box(float mnx, float mny, float mnz,
-        float mxx, float mxy, float mxz) :
-        mn(Vector3f(mnx, mny, mnz)),
-        mx(Vector3f(mxx, mxy, mxz))
-    {}
-};
+class CacheReader;
+class CacheWriter;
+class Mesh;
 
+// Octree nodes live in one array of sibling groups. A node is 8 bytes, so
+// the eight children of a node fill exactly one 64 byte cache line.
 struct OctNode
 {
-    OctNode *child[8];
+    int first; // inner: index of the child group; leaf: first slot in Octree::trigs
+    int count; // leaf: number of triangles; -1 for inner nodes
 
-    OctNode() {
-        for (int i = 0; i < 8; ++i) {
-            child[i] = nullptr;
-        }
-    }
-    ~OctNode() {
-        for (int i = 0; i < 8; ++i) {
-            delete child[i];
-        }
+    OctNode() :
+        first(0),
+        count(0)
+    {
     }
 
     ///@brief is this terminal
-    bool isTerm() {
-        return child[0] == nullptr;
+    bool isTerm() const {
+        return count >= 0;
     }
+};
 
-    std::vector<int> obj;
+struct alignas(64) OctGroup
+{
+    OctNode child[8];
 };
 
 class Octree
@@ -52,30 +42,82 @@ class Octree
     {
     }
 
-    void build(Mesh *m);
+    // Builds the tree over m's triangles on up to `threads` workers (see
+    // parallelFor). The result does not depend on the number of threads.
+    void build(const Mesh *m, int threads = 0);
 
-    bool intersect(const Ray &ray);
+    // The built tree in a mesh cache; load() fails if the cache was built
+    // with other parameters.
+    void save(CacheWriter &out) const;
+    bool load(CacheReader &in, const Mesh *m);
+
+    // Closest hit against the mesh triangles. Does not modify the tree,
+    // so any number of threads may traverse it at once.
+    bool intersect(const Ray &ray, float tmin, Hit &h) const;
+
+    // Any-hit query: is some triangle hit with tmin < t < tmax?
+    // Returns as soon as the first one is found.
+    bool occluded(const Ray &ray, float tmin, float tmax) const;
+
+    const Box &bounds() const {
+        return box;
+    }
+
+    // bytes held by the nodes and their triangle index lists
+    size_t memoryUsage() const;
 
   private:
-    void buildNode(OctNode *parent, 
-                   const Box &pbox,
-                   const std::vector<int> &trigs, 
-                   const Mesh &m, 
-                   int level);
+    // per-ray traversal state, kept on the caller's stack
+    struct Traversal
+    {
+        const Ray &ray;
+        float tmin;
+        Hit *hit;   // closest hit query; nullptr for an occlusion query
+        float tmax; // end of the occlusion query range
+        uint8_t aa; // child index mirror mask for negative ray directions
+        long long nodeVisits;
+        long long triangleTests;
+
+        // nothing beyond this t can change the answer any more
+        float limit() const {
+            return hit ? hit->getT() : tmax;
+        }
+    };
+
+    // sets up the mirrored ray and runs proc_subtree from the root
+    bool traverse(Traversal &tr) const;
+
+    struct Subtree;
+
+    // Splits pbox into its eight children and the node's triangles among
+    // them: child ii gets childTrigs[start[ii], start[ii + 1]).
+    static void split(const Box &pbox, const int *nodeTrigs, int n,
+                      const std::vector<Box> &bounds, std::vector<uint8_t> &masks,
+                      Box cBox[8], std::vector<int> &childTrigs, int start[9]);
+
+    // Builds the subtree of triangles nodeTrigs[0, n) in pbox into out.
+    OctNode buildNode(const Box &pbox,
+                      const int *nodeTrigs, int n,
+                      int level,
+                      Subtree &out) const;
 
     bool proc_subtree(float tx0, float ty0, float tz0, 
                       float tx1, float ty1, float tz1, 
-                      OctNode *node, const Ray &r);
+                      const OctNode *root, Traversal &tr) const;
 
     // if a node contains more than 7 triangles and it 
     // hasn't reached the max level yet, split
     static const int max_trig = 7;
 
+    // inner nodes on the traversal stack; maxLevel must stay below this
+    static const int max_depth = 32;
+
     int maxLevel;
-    Mesh *mesh;
+    const Mesh *mesh;
     Box box;
     OctNode root;
-    uint8_t aa;
+    std::vector<OctGroup> groups; // depth-first; children of a node are one group
+    std::vector<int> trigs;       // triangle indices of all leaves, back to back
 };
 
 #endif
@@ -0,0 +1,188 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int defaultThreadCount()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? (int)n : 1;
+}
+
+namespace
+{
+struct WorkDeque
+{
+    std::mutex lock;
+    std::deque<int> items;
+
+    bool popFront(int &item)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    bool stealBack(int &item)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty())
+            return false;
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+};
+
+// One parallelFor call: its items dealt out to `threads` slots, slot 0
+// being the calling thread and the others taken by pool workers.
+struct Job
+{
+    const std::function<void(int)> &body;
+    int threads;
+    std::vector<WorkDeque> deques;
+    int slots = 1; // next slot to hand out, guarded by the pool's lock
+    int busy = 0;  // pool workers inside run(), guarded by lock
+    std::mutex lock;
+    std::condition_variable idle;
+
+    Job(int count, int threads, const std::function<void(int)> &body)
+        : body(body), threads(threads), deques(threads)
+    {
+        for (int t = 0; t < threads; ++t)
+        {
+            int begin = (int)((long long)count * t / threads);
+            int end = (int)((long long)count * (t + 1) / threads);
+            for (int i = begin; i < end; ++i)
+                deques[t].items.push_back(i);
+        }
+    }
+
+    void run(int self)
+    {
+        int item;
+        while (true)
+        {
+            if (deques[self].popFront(item))
+            {
+                body(item);
+                continue;
+            }
+            // Own queue is drained: try every victim once, starting with the
+            // next worker so thieves spread out instead of hammering worker 0.
+            bool stolen = false;
+            for (int k = 1; k < threads && !stolen; ++k)
+                stolen = deques[(self + k) % threads].stealBack(item);
+            if (!stolen)
+                return; // nothing left anywhere; items are never re-queued
+            body(item);
+        }
+    }
+};
+
+// Workers that stay around for the whole run and take the free slots of
+// the posted jobs. Each keeps its thread, and so its Stats block, for good.
+class Pool
+{
+  public:
+    // Lists job until its slots are taken, with at least `helpers` workers
+    // around to take them.
+    void post(Job *job, int helpers)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        for (; _workers < helpers; ++_workers)
+            std::thread(&Pool::work, this).detach();
+        _jobs.push_back(job);
+        _wake.notify_all();
+    }
+
+    // Takes job off the list; no worker joins it afterwards.
+    void retract(Job *job)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        auto it = std::find(_jobs.begin(), _jobs.end(), job);
+        if (it != _jobs.end())
+            _jobs.erase(it);
+    }
+
+  private:
+    void work()
+    {
+        while (true)
+        {
+            Job *job;
+            int self;
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _wake.wait(guard, [this] { return !_jobs.empty(); });
+                job = _jobs.front();
+                self = job->slots++;
+                if (job->slots == job->threads)
+                    _jobs.pop_front();
+                std::lock_guard<std::mutex> jobGuard(job->lock);
+                ++job->busy;
+            }
+            job->run(self);
+            // the caller frees job once busy drops to 0, so this is the last
+            // access to it
+            std::lock_guard<std::mutex> jobGuard(job->lock);
+            if (--job->busy == 0)
+                job->idle.notify_all();
+        }
+    }
+
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::deque<Job *> _jobs;
+    int _workers = 0;
+};
+
+// never destroyed: the workers are still waiting for jobs at exit
+Pool &pool()
+{
+    static Pool *p = new Pool;
+    return *p;
+}
+}
+
+void parallelFor(int count, int threads, const std::function<void(int)> &body)
+{
+    if (threads <= 0)
+        threads = defaultThreadCount();
+    threads = std::min(threads, count);
+
+    if (threads <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    // The caller works on the job too, so it finishes even when every pool
+    // worker is busy elsewhere, e.g. in the parallelFor this one is nested in.
+    Job job(count, threads, body);
+    pool().post(&job, threads - 1);
+    job.run(0);
+    pool().retract(&job);
+    std::unique_lock<std::mutex> guard(job.lock);
+    job.idle.wait(guard, [&] { return job.busy == 0; });
+}
+
+void parallelRanges(size_t count, size_t grain, int threads,
+                    const std::function<void(size_t, size_t)> &body)
+{
+    grain = std::max<size_t>(grain, 1);
+    size_t runs = (count + grain - 1) / grain;
+    parallelFor((int)runs, threads, [&](int run)
+    {
+        size_t begin = (size_t)run * grain;
+        body(begin, std::min(begin + grain, count));
+    });
+}
@@ -0,0 +1,30 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Number of workers to use when the user did not ask for a specific count.
+int defaultThreadCount();
+
+// Runs body(i) for every i in [0, count) on up to `threads` workers
+// (threads <= 0 means defaultThreadCount()).
+//
+// Indices are dealt out to the workers in contiguous runs so that neighbouring
+// work items (e.g. image tiles) stay on the same core. A worker pops items from
+// the front of its own deque; once that is empty it steals from the back of
+// the other workers' deques, so a few expensive items cannot leave the rest of
+// the machine idle.
+//
+// The calling thread takes part, and the other workers come from a pool
+// that lives as long as the process, so a call does not start threads and
+// nested calls share the same workers.
+void parallelFor(int count, int threads, const std::function<void(int)> &body);
+
+// parallelFor over [0, count) cut into runs of `grain` indices: body(begin,
+// end) handles one run, for loops whose items are too cheap to schedule one
+// by one.
+void parallelRanges(size_t count, size_t grain, int threads,
+                    const std::function<void(size_t, size_t)> &body);
+
+#endif // PARALLEL_H
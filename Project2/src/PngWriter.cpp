@@ -0,0 +1,439 @@
+#include "PngWriter.h"
+
+#include "Image.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace
+{
+const int windowSize = 32768;
+const int hashBits = 15;
+const int minMatch = 3, maxMatch = 258;
+const int maxChain = 32;   // earlier positions tried per match search
+const int lazyLength = 32; // shorter matches wait to see if the next one is longer
+const size_t pieceSize = 256 * 1024; // input compressed as one piece, at least windowSize
+const int filterRun = 32;            // rows filtered together on one worker
+const size_t maxChunk = 1u << 30;
+
+// RFC 1951, 3.2.5: first length / distance of every code and its extra bits
+const int lengthBase[29] = {3,   4,   5,   6,   7,   8,   9,   10,  11,  13,
+                            15,  17,  19,  23,  27,  31,  35,  43,  51,  59,
+                            67,  83,  99,  115, 131, 163, 195, 227, 258};
+const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                             2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int distanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                              17,   25,   33,   49,   65,   97,    129,   193,
+                              257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                              4097, 6145, 8193, 12289, 16385, 24577};
+const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,  4,  4,  5,  5,  6,
+                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+uint32_t
+hash3(const uint8_t *p)
+{
+    return ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16) * 2654435761u >>
+           (32 - hashBits);
+}
+
+struct CrcTable
+{
+    uint32_t entry[256];
+
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entry[n] = c;
+        }
+    }
+};
+
+uint32_t
+crc32(uint32_t crc, const uint8_t *p, size_t n)
+{
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc = table.entry[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void
+put32(std::vector<uint8_t> &out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+int
+paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// Filters line (below prior) into out: the filter type byte and the row.
+// Every row gets the filter whose output has the smallest sum of absolute
+// values, the heuristic of the PNG specification (and of stb_image_write).
+// filtered is scratch space for 5 rows.
+void
+filterRow(const uint8_t *prior, const uint8_t *line, int stride, uint8_t *filtered, uint8_t *out)
+{
+    uint8_t *f = filtered;
+    for (int i = 0; i < stride; i++) {
+        int a = i >= 3 ? line[i - 3] : 0, b = prior[i], c = i >= 3 ? prior[i - 3] : 0;
+        int x = line[i];
+        f[i] = (uint8_t)x;
+        f[stride + i] = (uint8_t)(x - a);
+        f[2 * stride + i] = (uint8_t)(x - b);
+        f[3 * stride + i] = (uint8_t)(x - (a + b) / 2);
+        f[4 * stride + i] = (uint8_t)(x - paeth(a, b, c));
+    }
+    int best = 0;
+    long long bestSum = -1;
+    for (int type = 0; type < 5; type++) {
+        long long sum = 0;
+        for (int i = 0; i < stride; i++) {
+            sum += abs((int8_t)f[type * stride + i]);
+        }
+        if (bestSum < 0 || sum < bestSum) {
+            best = type;
+            bestSum = sum;
+        }
+    }
+    out[0] = (uint8_t)best;
+    std::copy(f + best * stride, f + (best + 1) * stride, out + 1);
+}
+}
+
+Deflater::Deflater() :
+    _bits(0),
+    _count(0),
+    _started(false),
+    _adler1(1),
+    _adler2(0)
+{
+}
+
+void
+Deflater::start(std::vector<uint8_t> &out)
+{
+    if (!_started) {
+        // zlib header: deflate with a 32 KiB window
+        out.push_back(0x78);
+        out.push_back(0x5e);
+        _started = true;
+    }
+}
+
+void
+Deflater::bits(uint32_t value, int count, std::vector<uint8_t> &out)
+{
+    _bits |= value << _count;
+    _count += count;
+    while (_count >= 8) {
+        out.push_back((uint8_t)_bits);
+        _bits >>= 8;
+        _count -= 8;
+    }
+}
+
+void
+Deflater::code(uint32_t code, int length, std::vector<uint8_t> &out)
+{
+    // Huffman codes go out most significant bit first
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+        reversed = reversed << 1 | (code >> i & 1);
+    }
+    bits(reversed, length, out);
+}
+
+void
+Deflater::literal(int symbol, std::vector<uint8_t> &out)
+{
+    // the fixed literal / length code of RFC 1951, 3.2.6
+    if (symbol < 144) {
+        code(0x30 + symbol, 8, out);
+    } else if (symbol < 256) {
+        code(0x190 + symbol - 144, 9, out);
+    } else if (symbol < 280) {
+        code(symbol - 256, 7, out);
+    } else {
+        code(0xc0 + symbol - 280, 8, out);
+    }
+}
+
+void
+Deflater::match(int length, int distance, std::vector<uint8_t> &out)
+{
+    int l = (int)(std::upper_bound(lengthBase, lengthBase + 29, length) - lengthBase) - 1;
+    literal(257 + l, out);
+    bits(length - lengthBase[l], lengthExtra[l], out);
+    int d = (int)(std::upper_bound(distanceBase, distanceBase + 30, distance) - distanceBase) - 1;
+    code(d, 5, out);
+    bits(distance - distanceBase[d], distanceExtra[d], out);
+}
+
+void
+Deflater::align(std::vector<uint8_t> &out)
+{
+    if (_count) {
+        bits(0, 8 - _count, out);
+    }
+}
+
+void
+Deflater::checksum(const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size;) {
+        // 5552 bytes keep the sums below 2^32 between reductions
+        size_t end = std::min(size, i + 5552);
+        for (; i < end; i++) {
+            _adler1 += data[i];
+            _adler2 += _adler1;
+        }
+        _adler1 %= 65521;
+        _adler2 %= 65521;
+    }
+}
+
+void
+Deflater::compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, int threads)
+{
+    start(out);
+    checksum(data, size);
+    size_t pieces = (size + pieceSize - 1) / pieceSize;
+    if (pieces <= 1) {
+        deflate(data, size, out);
+        return;
+    }
+
+    // Every piece starts on a Deflater of its own with the input before it
+    // as the window; the pieces end byte aligned with nothing pending, so
+    // their output joins up as if this one had compressed them in turn.
+    std::vector<std::vector<uint8_t>> outputs(pieces);
+    parallelFor((int)pieces, threads, [&](int i) {
+        size_t begin = i * pieceSize, end = std::min(size, begin + pieceSize);
+        Deflater piece;
+        if (i) {
+            piece._window.assign(data + begin - windowSize, data + begin);
+        } else {
+            piece._window = _window;
+        }
+        piece.deflate(data + begin, end - begin, outputs[i]);
+    });
+    for (const std::vector<uint8_t> &piece : outputs) {
+        out.insert(out.end(), piece.begin(), piece.end());
+    }
+    _window.assign(data + size - windowSize, data + size);
+}
+
+void
+Deflater::deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    // The window and the new data in one buffer, so that matches can reach
+    // back into the earlier pieces.
+    std::vector<uint8_t> buf(_window);
+    buf.insert(buf.end(), data, data + size);
+    int n = (int)buf.size(), begin = (int)_window.size();
+    _head.assign(1 << hashBits, -1);
+    _prev.resize(n);
+    auto insert = [&](int i) {
+        if (i + minMatch <= n) {
+            uint32_t h = hash3(&buf[i]);
+            _prev[i] = _head[h];
+            _head[h] = i;
+        }
+    };
+    // the longest match for position i among the positions inserted so far
+    auto longest = [&](int i, int &distance) {
+        if (i + minMatch > n) {
+            return 0;
+        }
+        int limit = std::min(maxMatch, n - i), best = 0, chain = maxChain;
+        for (int j = _head[hash3(&buf[i])]; j >= 0 && i - j <= windowSize && chain--;
+             j = _prev[j]) {
+            if (buf[j + best] != buf[i + best]) {
+                continue;
+            }
+            int length = 0;
+            while (length < limit && buf[j + length] == buf[i + length]) {
+                length++;
+            }
+            if (length > best) {
+                best = length;
+                distance = i - j;
+                if (length == limit) {
+                    break;
+                }
+            }
+        }
+        return best >= minMatch ? best : 0;
+    };
+    for (int i = 0; i < begin; i++) {
+        insert(i);
+    }
+
+    // BFINAL 0, BTYPE 01: fixed Huffman codes
+    bits(0, 1, out);
+    bits(1, 2, out);
+    for (int i = begin; i < n;) {
+        int distance = 0, length = longest(i, distance);
+        insert(i);
+        int next;
+        if (length && length < lazyLength && longest(i + 1, next) > length) {
+            length = 0;
+        }
+        if (!length) {
+            literal(buf[i++], out);
+            continue;
+        }
+        match(length, distance, out);
+        for (int k = 1; k < length; k++) {
+            insert(i + k);
+        }
+        i += length;
+    }
+    literal(256, out);
+
+    // sync flush: an empty stored block
+    bits(0, 3, out);
+    align(out);
+    bits(0, 16, out);
+    bits(0xffff, 16, out);
+
+    int keep = std::min(n, windowSize);
+    _window.assign(buf.end() - keep, buf.end());
+}
+
+void
+Deflater::finish(std::vector<uint8_t> &out)
+{
+    start(out);
+    bits(1, 1, out);
+    bits(1, 2, out);
+    literal(256, out);
+    align(out);
+    put32(out, _adler2 << 16 | _adler1);
+}
+
+PngWriter::PngWriter(const std::string &filename, int width, int height, int threads) :
+    _filename(filename),
+    _file(fopen(filename.c_str(), "wb")),
+    _failed(false),
+    _width(width),
+    _height(height),
+    _rows(0),
+    _threads(threads),
+    _prior(width * 3, 0)
+{
+    if (!_file) {
+        return;
+    }
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    _failed = fwrite(signature, 1, 8, _file) != 8;
+
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+    std::vector<uint8_t> header;
+    put32(header, width);
+    put32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    chunk("IHDR", header.data(), header.size());
+}
+
+PngWriter::~PngWriter()
+{
+    if (_file) {
+        fclose(_file);
+        remove(_filename.c_str());
+    }
+}
+
+void
+PngWriter::chunk(const char *type, const uint8_t *data, size_t size)
+{
+    uint8_t head[8];
+    for (int i = 0; i < 4; i++) {
+        head[i] = (uint8_t)(size >> (24 - 8 * i));
+        head[4 + i] = type[i];
+    }
+    uint8_t tail[4];
+    uint32_t crc = crc32(crc32(0, head + 4, 4), data, size);
+    for (int i = 0; i < 4; i++) {
+        tail[i] = (uint8_t)(crc >> (24 - 8 * i));
+    }
+    _failed |= fwrite(head, 1, 8, _file) != 8;
+    _failed |= fwrite(data, 1, size, _file) != size;
+    _failed |= fwrite(tail, 1, 4, _file) != 4;
+}
+
+void
+PngWriter::write(const Image &band)
+{
+    assert(band.getWidth() == _width);
+    assert(_rows + band.getHeight() <= _height);
+    if (!ok()) {
+        return;
+    }
+
+    // Output row r is band row rows - 1 - r. A run of rows is filtered
+    // from the row above it, so the runs can go to different workers.
+    int stride = _width * 3, rows = band.getHeight();
+    _raw.resize((size_t)rows * (stride + 1));
+    parallelRanges(rows, filterRun, _threads, [&](size_t begin, size_t end) {
+        std::vector<uint8_t> prior(stride), line(stride), filtered(stride * 5);
+        if (begin) {
+            band.rowBytes(rows - (int)begin, prior.data());
+        } else {
+            prior = _prior;
+        }
+        for (size_t r = begin; r < end; r++) {
+            band.rowBytes(rows - 1 - (int)r, line.data());
+            filterRow(prior.data(), line.data(), stride, filtered.data(),
+                      &_raw[r * (stride + 1)]);
+            std::swap(prior, line);
+        }
+    });
+    if (rows) {
+        band.rowBytes(0, _prior.data());
+    }
+    _rows += rows;
+
+    _out.clear();
+    _deflater.compress(_raw.data(), _raw.size(), _out, _threads);
+    // a chunk holds less than 2 GiB
+    for (size_t i = 0; i < _out.size(); i += maxChunk) {
+        chunk("IDAT", _out.data() + i, std::min(maxChunk, _out.size() - i));
+    }
+}
+
+bool
+PngWriter::finish()
+{
+    if (!_file) {
+        return false;
+    }
+    _out.clear();
+    _deflater.finish(_out);
+    chunk("IDAT", _out.data(), _out.size());
+    chunk("IEND", nullptr, 0);
+    bool ok = !_failed && _rows == _height;
+    ok &= fclose(_file) == 0;
+    _file = nullptr;
+    if (!ok) {
+        remove(_filename.c_str());
+    }
+    return ok;
+}
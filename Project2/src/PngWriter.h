@@ -0,0 +1,91 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class Image;
+
+// A zlib stream (RFC 1950 / 1951) that is compressed piece by piece. Every
+// piece is one block of fixed Huffman codes with LZ77 matches that may
+// reach back into the pieces before it, closed by a sync flush (an empty
+// stored block) so that the output of every piece ends on a byte boundary
+// and can be written out right away. Since a piece only needs the 32 KiB
+// of input before it, the pieces of a large input are compressed side by
+// side and their output concatenated, as pigz does.
+class Deflater
+{
+  public:
+    Deflater();
+
+    // Compresses the next size bytes of the stream and appends the output
+    // to out. The bytes are cut into pieces of 256 KiB that are compressed
+    // on up to `threads` workers (0 for all cores); the output does not
+    // depend on the thread count.
+    void compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out,
+                  int threads = 1);
+
+    // Closes the stream with a final empty block and the Adler-32 checksum.
+    void finish(std::vector<uint8_t> &out);
+
+  private:
+    void start(std::vector<uint8_t> &out);
+    void checksum(const uint8_t *data, size_t size);
+    // one piece, matched against _window, which it then moves past
+    void deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+    void bits(uint32_t value, int count, std::vector<uint8_t> &out);
+    void code(uint32_t code, int length, std::vector<uint8_t> &out);
+    void literal(int symbol, std::vector<uint8_t> &out);
+    void match(int length, int distance, std::vector<uint8_t> &out);
+    void align(std::vector<uint8_t> &out);
+
+    uint32_t _bits;               // pending output bits, the first in bit 0
+    int _count;
+    bool _started;
+    uint32_t _adler1, _adler2;    // Adler-32 of everything compressed
+    std::vector<uint8_t> _window; // the last 32 KiB of input
+    std::vector<int> _head, _prev;
+};
+
+// Writes an 8-bit RGB PNG file band by band, so that a render can hand
+// over its rows as it finishes them instead of holding the whole image.
+// Every band becomes an IDAT chunk with the next part of the Deflater
+// stream; its rows are filtered and compressed on the workers.
+class PngWriter
+{
+  public:
+    // Creates filename and writes the header of a width x height image,
+    // to be encoded on up to `threads` workers (0 for all cores); see ok().
+    PngWriter(const std::string &filename, int width, int height, int threads = 0);
+
+    // Closes the file; a file that was not finished is removed.
+    ~PngWriter();
+
+    // false once the file could not be created or written
+    bool ok() const {
+        return _file && !_failed;
+    }
+
+    // Appends the rows of band, which must be as wide as the image, top row
+    // (highest y) first like Image::savePNG(); the bands of an image come
+    // in from its top to its bottom.
+    void write(const Image &band);
+
+    // Writes the end of the file after the last band; false on any error.
+    bool finish();
+
+  private:
+    void chunk(const char *type, const uint8_t *data, size_t size);
+
+    std::string _filename;
+    FILE *_file;
+    bool _failed;
+    int _width, _height, _rows, _threads;
+    std::vector<uint8_t> _prior, _raw, _out;
+    Deflater _deflater;
+};
+
+#endif // PNG_WRITER_H
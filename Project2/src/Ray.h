@@ -15,18 +15,33 @@ class Ray
   public:
     Ray(const Vector3f &orig, const Vector3f &dir) :
         _origin(orig),
-        _direction(dir)
+        _direction(dir),
+        _invDirection(1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2])
     {
+        // taken from the reciprocal so that -0 counts as negative
+        for (int i = 0; i < 3; ++i) {
+            _sign[i] = _invDirection[i] < 0;
+        }
     }
 
-    const Vector3f getOrigin() const {
+    const Vector3f & getOrigin() const {
         return _origin;
     }
 
-    const Vector3f getDirection() const {
+    const Vector3f & getDirection() const {
         return _direction;
     }
 
+    // component-wise 1 / direction, for slab tests
+    const Vector3f & getInvDirection() const {
+        return _invDirection;
+    }
+
+    // 1 if the direction points towards -axis, else 0
+    int getSign(int axis) const {
+        return _sign[axis];
+    }
+
     Vector3f pointAtParameter(float t) const {
         return _origin + _direction * t;
     }
@@ -34,7 +49,8 @@ class Ray
   private:
     Vector3f _origin;
     Vector3f _direction;
-
+    Vector3f _invDirection;
+    unsigned char _sign[3];
 };
 
 inline std::ostream &
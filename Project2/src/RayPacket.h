@@ -0,0 +1,177 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "Box.h"
+#include "Ray.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Up to max_size rays traced together. Coordinates are stored per axis
+// (structure of arrays) so that SIMD_WIDTH lanes load with one instruction.
+//
+// Lanes [count, size) only pad the packet to a whole number of SIMD vectors;
+// they repeat lane 0, so kernels may compute them freely and callers ignore
+// whatever they produce.
+struct RayPacket
+{
+    static const int max_size = 16;
+
+    int count; // rays in the packet
+    int size;  // count rounded up to a multiple of SIMD_WIDTH
+
+    float ox[max_size], oy[max_size], oz[max_size];
+    float dx[max_size], dy[max_size], dz[max_size];
+    float ix[max_size], iy[max_size], iz[max_size]; // 1 / direction
+    float tmin[max_size];
+
+    // Interval bounds over all lanes, for culling whole nodes in one test.
+    // Only valid when coherent: every axis has the same direction sign (and
+    // a finite reciprocal) in all lanes.
+    bool coherent;
+    Vector3f originMin, originMax, invMin, invMax;
+    float tminMin;
+
+    void set(int lane, const Ray &r, float t) {
+        const Vector3f &o = r.getOrigin(), &d = r.getDirection(), &inv = r.getInvDirection();
+        ox[lane] = o[0]; oy[lane] = o[1]; oz[lane] = o[2];
+        dx[lane] = d[0]; dy[lane] = d[1]; dz[lane] = d[2];
+        ix[lane] = inv[0]; iy[lane] = inv[1]; iz[lane] = inv[2];
+        tmin[lane] = t;
+    }
+
+    // Call once lanes [0, n) have been set: pads the packet and computes
+    // the interval bounds.
+    void finish(int n) {
+        count = n;
+        size = (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+        for (int lane = n; lane < size; ++lane) {
+            ox[lane] = ox[0]; oy[lane] = oy[0]; oz[lane] = oz[0];
+            dx[lane] = dx[0]; dy[lane] = dy[0]; dz[lane] = dz[0];
+            ix[lane] = ix[0]; iy[lane] = iy[0]; iz[lane] = iz[0];
+            tmin[lane] = tmin[0];
+        }
+
+        const float *o[3] = { ox, oy, oz }, *inv[3] = { ix, iy, iz };
+        coherent = true;
+        tminMin = tmin[0];
+        for (int lane = 0; lane < n; ++lane) {
+            tminMin = std::min(tminMin, tmin[lane]);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            originMin[axis] = originMax[axis] = o[axis][0];
+            invMin[axis] = invMax[axis] = inv[axis][0];
+            for (int lane = 0; lane < n; ++lane) {
+                originMin[axis] = std::min(originMin[axis], o[axis][lane]);
+                originMax[axis] = std::max(originMax[axis], o[axis][lane]);
+                invMin[axis] = std::min(invMin[axis], inv[axis][lane]);
+                invMax[axis] = std::max(invMax[axis], inv[axis][lane]);
+                coherent &= std::isfinite(inv[axis][lane]) &&
+                            (inv[axis][lane] < 0) == (inv[axis][0] < 0);
+            }
+        }
+    }
+
+    // rebuilds lane i as a single ray
+    Ray ray(int lane) const {
+        return Ray(Vector3f(ox[lane], oy[lane], oz[lane]),
+                   Vector3f(dx[lane], dy[lane], dz[lane]));
+    }
+
+    // lanes [c, c + SIMD_WIDTH)
+    vec3v origin(int c) const {
+        return { vfloat::load(ox + c), vfloat::load(oy + c), vfloat::load(oz + c) };
+    }
+    vec3v direction(int c) const {
+        return { vfloat::load(dx + c), vfloat::load(dy + c), vfloat::load(dz + c) };
+    }
+    vec3v invDirection(int c) const {
+        return { vfloat::load(ix + c), vfloat::load(iy + c), vfloat::load(iz + c) };
+    }
+
+    // Interval arithmetic test: true if no lane can hit the box within
+    // [tmin, tmax]. Conservative, so a false answer proves nothing.
+    bool missesBox(const Box &b, float tmax) const {
+        if (!coherent) {
+            return false;
+        }
+        float lo = tminMin, hi = tmax;
+        for (int axis = 0; axis < 3; ++axis) {
+            bool neg = invMin[axis] < 0;
+            float nearPlane = neg ? b.mx[axis] : b.mn[axis];
+            float farPlane = neg ? b.mn[axis] : b.mx[axis];
+            // bounds of (plane - o) * inv over o and inv in their intervals;
+            // rounding is monotonic, so every lane lies within them
+            float n0 = (nearPlane - originMax[axis]) * invMin[axis];
+            float n1 = (nearPlane - originMax[axis]) * invMax[axis];
+            float n2 = (nearPlane - originMin[axis]) * invMin[axis];
+            float n3 = (nearPlane - originMin[axis]) * invMax[axis];
+            float f0 = (farPlane - originMax[axis]) * invMin[axis];
+            float f1 = (farPlane - originMax[axis]) * invMax[axis];
+            float f2 = (farPlane - originMin[axis]) * invMin[axis];
+            float f3 = (farPlane - originMin[axis]) * invMax[axis];
+            lo = std::max(lo, std::min(std::min(n0, n1), std::min(n2, n3)));
+            hi = std::min(hi, std::max(std::max(f0, f1), std::max(f2, f3)));
+        }
+        return lo > hi;
+    }
+
+    // Per-lane slab test, the same arithmetic as Box::intersect. Lane i
+    // counts if it enters the box before tmax[i]; returns the lane mask and
+    // the smallest entry distance among those lanes.
+    int intersectBox(const Box &b, const float *tmax, float &tnear) const {
+        const vfloat mn[3] = { b.mn[0], b.mn[1], b.mn[2] };
+        const vfloat mx[3] = { b.mx[0], b.mx[1], b.mx[2] };
+        const float *o[3] = { ox, oy, oz }, *inv[3] = { ix, iy, iz };
+
+        int mask = 0;
+        float entry[max_size];
+        for (int c = 0; c < size; c += SIMD_WIDTH) {
+            vfloat t0 = vfloat::load(tmin + c), t1 = vfloat::load(tmax + c);
+            for (int axis = 0; axis < 3; ++axis) {
+                vfloat oa = vfloat::load(o[axis] + c), ia = vfloat::load(inv[axis] + c);
+                vbool neg = ia < 0.0f;
+                vfloat n = (select(neg, mx[axis], mn[axis]) - oa) * ia;
+                vfloat f = (select(neg, mn[axis], mx[axis]) - oa) * ia;
+                t0 = select(n > t0, n, t0);
+                t1 = select(f < t1, f, t1);
+            }
+            mask |= movemask(!(t0 > t1)) << c;
+            t0.store(entry + c);
+        }
+        mask &= (1 << count) - 1;
+
+        tnear = std::numeric_limits<float>::max();
+        for (int bits = mask; bits; bits &= bits - 1) {
+            tnear = std::min(tnear, entry[ctz(bits)]);
+        }
+        return mask;
+    }
+
+    // closest hit distances of lanes [c, c + SIMD_WIDTH)
+    static vfloat hitDistances(const Hit *hits, int c) {
+        float t[SIMD_WIDTH];
+        for (int i = 0; i < SIMD_WIDTH; ++i) {
+            t[i] = hits[c + i].getT();
+        }
+        return vfloat::load(t);
+    }
+
+    // index of the lowest set bit
+    static int ctz(int bits) {
+        int i = 0;
+        while (!(bits & (1 << i))) {
+            ++i;
+        }
+        return i;
+    }
+};
+
+// the same point or vector in every lane
+inline vec3v splat(const Vector3f &v)
+{
+    return { v[0], v[1], v[2] };
+}
+
+#endif // RAY_PACKET_H
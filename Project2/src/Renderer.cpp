@@ -3,85 +3,715 @@
 #include "ArgParser.h"
 #include "Camera.h"
 #include "Image.h"
+#include "Parallel.h"
+#include "PngWriter.h"
 #include "Ray.h"
+#include "RayPacket.h"
+#include "SplatBuffer.h"
+#include "Stats.h"
 #include "VecUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 #include <limits>
-#include <random>
+#include <vector>
 #include <functional>
 
 Renderer::Renderer(const ArgParser &args) : _args(args),
-                                            _scene(args.input_file) {}
+                                            _created(std::chrono::steady_clock::now()),
+                                            _scene(args.input_file, args.accel, args.threads, args.mesh_cache),
+                                            _sampler(Sampler::create(args.sampler, args.samples)),
+                                            _filter(args.filter ? Filter::create(args.pixel_filter, args.filter_radius) : nullptr),
+                                            _color(!args.output_file.empty()),
+                                            _normals(!args.normals_file.empty()),
+                                            _depth(!args.depth_file.empty()),
+                                            _pixelAngle(0)
+{
+    if (!_sampler)
+    {
+        printf("Unknown sampler '%s'\n", args.sampler.c_str());
+        exit(1);
+    }
+    if (args.filter && !_filter)
+    {
+        printf("Unknown pixel filter '%s'\n", args.pixel_filter.c_str());
+        exit(1);
+    }
 
-constexpr int jittersamples = 16;
-constexpr int scale = 3, weight[3][3] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}}, sum = 16;
+    // the angle between the camera rays of neighbouring pixels
+    if (args.width > 1)
+    {
+        Camera *cam = _scene.getCamera();
+        Vector3f a = cam->generateRay(Vector2f(0, 0)).getDirection();
+        Vector3f b = cam->generateRay(Vector2f(2.0f / (args.width - 1), 0)).getDirection();
+        _pixelAngle = (b - a).abs();
+    }
+}
+
+Renderer::~Renderer()
+{
+    delete _sampler;
+    delete _filter;
+}
+
+constexpr int tileSize = 16;
+// adaptive rounds taken before the variance estimate is trusted
+constexpr int minRounds = 4;
 
 #define For(i, n) for (int i = 0; i < n; ++i)
+
+// Workers for each of `images` files encoded at the same time.
+static int perImageThreads(const ArgParser &args, int images)
+{
+    int threads = args.threads > 0 ? args.threads : defaultThreadCount();
+    return std::max(1, (threads + images - 1) / std::max(1, images));
+}
 void Renderer::Render()
 {
     int w = _args.width, h = _args.height;
-    int samples = _args.jitter ? jittersamples : 1;
-    auto jitter = _args.jitter ? ([]
-                                  { static std::default_random_engine generator;
-                                    static std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
-                                    return distribution(generator); })
-                               : ([]
-                                  { return 0.0f; });
+    auto start = std::chrono::steady_clock::now();
+    if (_args.stream)
+    {
+        renderStreaming(start);
+        return;
+    }
 
-    Image image(w, h), nimage(w, h), dimage(w, h);
+    Film film(_args, w, h);
+    if (_args.progressive)
+        renderProgressive(film);
+    else if (_filter)
+    {
+        SplatBuffer splats(0, 0, w, h);
+        renderRows(0, h, nullptr, &splats);
+        film.set(splats, 0);
+    }
+    else
+        renderRows(0, h, &film, nullptr);
+    finish(start, film);
+}
 
-    Camera *cam = _scene.getCamera();
+static Image filmImage(const ArgParser &args, const std::string &file, int width, int height)
+{
+    if (file.empty())
+        return Image();
+    return Image(width, height, args.half_film ? Image::Half : Image::Float);
+}
 
-    if (!_args.filter)
-        For(y, h) For(x, w)
+Renderer::Film::Film(const ArgParser &args, int width, int height) :
+    width(width),
+    height(height),
+    color(filmImage(args, args.output_file, width, height)),
+    normals(filmImage(args, args.normals_file, width, height)),
+    depth(filmImage(args, args.depth_file, width, height))
+{
+}
+
+void Renderer::Film::set(int x, int y, const Vector3f &c, const Vector3f &n, float d)
+{
+    if (color.getWidth())
+        color.setPixel(x, y, c);
+    if (normals.getWidth())
+        normals.setPixel(x, y, n);
+    if (depth.getWidth())
+        depth.setPixel(x, y, Vector3f(d));
+}
+
+void Renderer::Film::set(const SplatBuffer &splats, int y0)
+{
+    For(y, height) For(x, width)
+    {
+        Vector3f c, n;
+        float d;
+        splats.resolve(x, y0 + y, c, n, d);
+        set(x, y, c, n, d);
+    }
+}
+
+int Renderer::filterMargin() const
+{
+    // a sample lies within half a pixel of its pixel's center
+    return _filter ? (int)std::ceil(_filter->radius() - 0.5f) : 0;
+}
+
+void Renderer::forTiles(int ry0, int ry1, SplatBuffer *splats,
+                        const std::function<void(int, int, int, int, SplatBuffer *)> &body) const
+{
+    // Split the rows into tiles and let the workers steal them from each
+    // other; every pixel only depends on its own coordinates, so the output
+    // is the same for any thread count.
+    int w = _args.width, h = _args.height, m = filterMargin();
+    int tilesX = (w + tileSize - 1) / tileSize;
+    int tilesY = (ry1 - ry0 + tileSize - 1) / tileSize;
+    std::vector<SplatBuffer *> tiles(splats ? tilesX * tilesY : 0);
+    parallelFor(tilesX * tilesY, _args.threads, [&](int tile)
+    {
+        int x0 = tile % tilesX * tileSize, y0 = ry0 + tile / tilesX * tileSize;
+        int x1 = std::min(x0 + tileSize, w), y1 = std::min(y0 + tileSize, ry1);
+        SplatBuffer *s = nullptr;
+        if (splats)
         {
-            Vector3f color = {0, 0, 0}, norm = {0, 0, 0};
-            float depth = 0;
-            For(_, samples)
+            int sx0 = std::max(0, x0 - m), sy0 = std::max(0, y0 - m);
+            s = tiles[tile] = new SplatBuffer(sx0, sy0, std::min(w, x1 + m) - sx0,
+                                              std::min(h, y1 + m) - sy0);
+        }
+        body(x0, y0, x1, y1, s);
+    });
+    if (!splats)
+        return;
+
+    // The tiles overlap by their margins. Add them up row by row, the tiles
+    // of every row from the top of the image down as streamed bands come
+    // in, so that a pixel sums its samples in the same order whatever the
+    // thread count and band size.
+    int by = std::max(splats->y0(), ry0 - m), ey = std::min(splats->y1(), ry1 + m);
+    parallelRanges(std::max(0, ey - by), tileSize, _args.threads, [&](size_t begin, size_t end)
+    {
+        for (int y = by + (int)begin; y < by + (int)end; ++y)
+        {
+            // the margin is below tileSize: only tile rows t - 1 to t + 1 reach y
+            int t = (y - ry0 + tileSize) / tileSize - 1;
+            for (int ty = std::min(tilesY - 1, t + 1); ty >= std::max(0, t - 1); --ty)
+                For(tx, tilesX)
+                    splats->addRow(*tiles[ty * tilesX + tx], y);
+        }
+    });
+    for (SplatBuffer *s : tiles)
+        delete s;
+}
+
+void Renderer::renderRows(int ry0, int ry1, Film *film, SplatBuffer *splats) const
+{
+    forTiles(ry0, ry1, splats, [&](int x0, int y0, int x1, int y1, SplatBuffer *s)
+    {
+        if (_args.packet)
+        {
+            // square-ish blocks of pixels, one packet lane each
+            int pw = _args.packet == 4 ? 2 : 4, ph = _args.packet / pw;
+            for (int by = y0; by < y1; by += ph)
+                for (int bx = x0; bx < x1; bx += pw)
+                {
+                    int bw = std::min(pw, x1 - bx), bh = std::min(ph, y1 - by);
+                    Vector3f color[RayPacket::max_size], norm[RayPacket::max_size];
+                    float depth[RayPacket::max_size];
+                    if (_args.adaptive)
+                        renderAdaptivePacket(bx, by, bw, bh, color, norm, depth, s);
+                    else
+                        renderPacket(bx, by, bw, bh, color, norm, depth, s);
+                    if (film)
+                        For(i, bw * bh)
+                            film->set(bx + i % bw, by + i / bw - ry0, color[i], norm[i], depth[i]);
+                }
+            return;
+        }
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x)
             {
-                float ndcy = 2 * ((y + jitter()) / (h - 1.0f)) - 1.0f;
-                float ndcx = 2 * ((x + jitter()) / (w - 1.0f)) - 1.0f;
-                Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
-                Hit h;
-                color += traceRay(r, cam->getTMin(), _args.bounces, h);
-                norm += (h.getNormal() + 1.0f) / 2.0f;
-                float range = (_args.depth_max - _args.depth_min);
-                if (range)
-                    depth += (h.t - _args.depth_min) / range;
+                Vector3f color, norm;
+                float depth;
+                if (_args.adaptive)
+                    renderAdaptive(x, y, color, norm, depth, s);
+                else
+                    renderPixel(x, y, color, norm, depth, s);
+                if (film)
+                    film->set(x, y - ry0, color, norm, depth);
+            }
+    });
+}
+
+void Renderer::renderStreaming(std::chrono::steady_clock::time_point start) const
+{
+    int w = _args.width, h = _args.height;
+    const std::string *files[3] = {&_args.output_file, &_args.normals_file, &_args.depth_file};
+    PngWriter *writers[3] = {};
+    int encoders = perImageThreads(_args, !files[0]->empty() + !files[1]->empty() +
+                                              !files[2]->empty());
+    For(i, 3)
+        if (files[i]->size())
+        {
+            writers[i] = new PngWriter(*files[i], w, h, encoders);
+            if (!writers[i]->ok())
+            {
+                std::cout << "Cannot open " << *files[i] << "\n";
+                exit(1);
             }
-            image.setPixel(x, y, color / samples);
-            nimage.setPixel(x, y, norm / samples);
-            dimage.setPixel(x, y, Vector3f(depth / samples));
         }
-    else
+    auto write = [&](const Film &band)
+    {
+        const Image *images[3] = {&band.color, &band.normals, &band.depth};
+        parallelFor(3, 3, [&](int i)
+        {
+            if (writers[i])
+                writers[i]->write(*images[i]);
+        });
+    };
+
+    // Bands are whole rows of tiles, enough of them to keep every worker
+    // busy, and go from the top of the image down as PNG wants its rows.
+    int threads = _args.threads > 0 ? _args.threads : defaultThreadCount();
+    int tilesX = (w + tileSize - 1) / tileSize;
+    int bandRows = tileSize * std::max(1, (4 * threads + tilesX - 1) / tilesX);
+    int m = filterMargin(), written = h;
+    SplatBuffer *splats = nullptr;
+    for (int y1 = h, y0; y1 > 0; y1 = y0)
+    {
+        y0 = (y1 - 1) / bandRows * bandRows;
+        if (!_filter)
+        {
+            Film band(_args, w, y1 - y0);
+            renderRows(y0, y1, &band, nullptr);
+            write(band);
+            continue;
+        }
+
+        // The samples of a band reach m rows into the bands next to it:
+        // carry the rows still waiting for samples over to the next band's
+        // buffer, and write the rows that no band below can reach.
+        int sy0 = std::max(0, y0 - m), sy1 = std::min(h, y1 + m);
+        SplatBuffer *next = new SplatBuffer(0, sy0, w, sy1 - sy0);
+        if (splats)
+            for (int y = y1 - m; y < sy1; ++y)
+                next->addRow(*splats, y);
+        delete splats;
+        splats = next;
+        renderRows(y0, y1, nullptr, splats);
+        int done = y0 ? std::min(h, y0 + m) : 0;
+        if (done < written)
+        {
+            Film band(_args, w, written - done);
+            band.set(*splats, done);
+            write(band);
+            written = done;
+        }
+    }
+    delete splats;
+
+    if (_args.stats)
+        Stats::report(std::cout, std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start).count());
+    For(i, 3)
+        if (writers[i])
+        {
+            if (!writers[i]->finish())
+                std::cout << "Cannot write " << *files[i] << "\n";
+            delete writers[i];
+        }
+}
+
+void Renderer::finish(std::chrono::steady_clock::time_point start, const Film &film) const
+{
+    if (_args.stats)
+        Stats::report(std::cout, std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start).count());
+    save(film);
+}
+
+void Renderer::save(const Film &film) const
+{
+    // the images are written side by side, PNGs each encoded on its share of
+    // the workers
+    const Image *images[3] = {&film.color, &film.normals, &film.depth};
+    const std::string *files[3] = {&_args.output_file, &_args.normals_file, &_args.depth_file};
+    bool wanted[3] = {_color, _normals, _depth}, saved[3] = {};
+    int encoders = perImageThreads(_args, wanted[0] + wanted[1] + wanted[2]);
+    parallelFor(3, 3, [&](int i)
+    {
+        if (wanted[i])
+        {
+            if (_args.format == "pfm")
+                saved[i] = images[i]->savePFM(*files[i]);
+            else if (_args.format == "exr")
+                saved[i] = images[i]->saveEXR(*files[i]);
+            else
+                saved[i] = images[i]->savePNG(*files[i], encoders);
+        }
+    });
+    For(i, 3)
+        if (wanted[i] && !saved[i])
+            std::cout << "Cannot write " << *files[i] << "\n";
+}
+
+// set by SIGTERM / SIGINT during a progressive render
+static std::atomic<bool> stopSignal(false);
+
+static void onStopSignal(int)
+{
+    stopSignal = true;
+}
+
+void Renderer::renderProgressive(Film &film) const
+{
+    using Clock = std::chrono::steady_clock;
+    int w = _args.width, h = _args.height;
+    std::vector<Estimate> est((size_t)w * h);
+    SplatBuffer *splats = _filter ? new SplatBuffer(0, 0, w, h) : nullptr;
+    auto resolveAll = [&]
+    {
+        if (splats)
+        {
+            film.set(*splats, 0);
+            return;
+        }
         For(y, h) For(x, w)
         {
-            Vector3f color = {0, 0, 0}, norm = {0, 0, 0};
-            float depth = 0;
-            For(i, scale) For(j, scale)
-                For(_, samples)
+            Vector3f color, norm;
+            float depth;
+            est[(size_t)y * w + x].resolve(color, norm, depth);
+            film.set(x, y, color, norm, depth);
+        }
+    };
+
+    // the budget runs from the start of the program, scene loading included
+    auto deadline = _created + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(_args.time_budget));
+    auto stopNow = [&]
+    {
+        return stopSignal || (_args.time_budget > 0 && Clock::now() >= deadline);
+    };
+    stopSignal = false;
+    auto oldTerm = std::signal(SIGTERM, onStopSignal);
+    auto oldInt = std::signal(SIGINT, onStopSignal);
+
+    // Every pass takes one more round (see Estimate) of every pixel that
+    // still wants samples, tile by tile; a stop request lets the tiles in
+    // flight finish and skips the rest.
+    int passes = maxRounds(), pass = 0;
+    auto lastCheckpoint = Clock::now();
+    bool interrupted = false;
+    for (; pass < passes; ++pass)
+    {
+        if (stopNow())
+        {
+            interrupted = true;
+            break;
+        }
+        std::atomic<long long> sampled(0);
+        std::atomic<bool> skipped(false);
+        forTiles(0, h, splats, [&](int x0, int y0, int x1, int y1, SplatBuffer *s)
+        {
+            if (stopNow())
             {
-                float ndcy = 2 * ((y * scale + i + jitter()) / (h * scale - 1.0f)) - 1.0f;
-                float ndcx = 2 * ((x * scale + j + jitter()) / (w * scale - 1.0f)) - 1.0f;
-                Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
-                Hit h;
-                color += traceRay(r, cam->getTMin(), _args.bounces, h) * weight[i][j];
-                norm += (h.getNormal() + 1.0f) / 2.0f * weight[i][j];
-                float range = (_args.depth_max - _args.depth_min);
-                if (range)
-                    depth += (h.t - _args.depth_min) / range * weight[i][j];
+                skipped = true;
+                return;
             }
-            image.setPixel(x, y, color / sum / samples);
-            nimage.setPixel(x, y, norm / sum / samples);
-            dimage.setPixel(x, y, Vector3f(depth / sum / samples));
+            long long n = 0;
+            if (_args.packet)
+            {
+                int pw = _args.packet == 4 ? 2 : 4, ph = _args.packet / pw;
+                for (int by = y0; by < y1; by += ph)
+                    for (int bx = x0; bx < x1; bx += pw)
+                    {
+                        int bw = std::min(pw, x1 - bx), bh = std::min(ph, y1 - by);
+                        Estimate *lane[RayPacket::max_size];
+                        For(i, bw * bh)
+                            lane[i] = &est[(size_t)(by + i / bw) * w + bx + i % bw];
+                        n += sampleRoundPacket(bx, by, bw, bh, lane, s);
+                    }
+            }
+            else
+            {
+                for (int y = y0; y < y1; ++y)
+                    for (int x = x0; x < x1; ++x)
+                    {
+                        Estimate &e = est[(size_t)y * w + x];
+                        if (!e.done)
+                        {
+                            sampleRound(x, y, e, s);
+                            n++;
+                        }
+                    }
+            }
+            sampled += n;
+        });
+        if (skipped)
+        {
+            interrupted = true;
+            break;
+        }
+        if (!sampled)
+            break; // adaptive sampling is done with every pixel
+
+        if (pass + 1 < passes && _args.checkpoint > 0 &&
+            Clock::now() - lastCheckpoint >= std::chrono::duration<double>(_args.checkpoint))
+        {
+            resolveAll();
+            save(film);
+            lastCheckpoint = Clock::now();
+            std::cout << "Checkpoint after pass " << pass + 1 << " of " << passes << std::endl;
+        }
+    }
+    std::signal(SIGTERM, oldTerm);
+    std::signal(SIGINT, oldInt);
+
+    resolveAll();
+    delete splats;
+    Stats::local().fixedSamples += (long long)w * h * samplesPerPixel();
+    if (interrupted)
+        std::cout << "Stopped in pass " << pass + 1 << " of " << passes << " ("
+                  << (stopSignal ? "signal" : "time budget") << ")" << std::endl;
+}
+
+int Renderer::samplesPerPixel() const
+{
+    return _args.jitter ? _args.samples : 1;
+}
+
+Renderer::Sample Renderer::pixelSample(int x, int y, int index) const
+{
+    int w = _args.width, h = _args.height;
+    Vector2f offset(0, 0);
+    if (_args.jitter)
+    {
+        // With a filter a sample stays within its pixel and the filter
+        // weighs it for the pixels around; without one the samples spread
+        // over the neighbouring pixels themselves.
+        Vector2f u = _sampler->sample(x, y, index);
+        offset = _filter ? u - Vector2f(0.5f, 0.5f) : 2 * u - Vector2f(1, 1);
+    }
+    float px = x + offset[0], py = y + offset[1];
+    return {2 * (px / (w - 1.0f)) - 1.0f, 2 * (py / (h - 1.0f)) - 1.0f, px, py};
+}
+
+int Renderer::maxRounds() const
+{
+    return _args.adaptive ? _args.max_samples : samplesPerPixel();
+}
+
+void Renderer::Estimate::resolve(Vector3f &c, Vector3f &n, float &d) const
+{
+    if (!rounds)
+    {
+        // never sampled: a progressive render stopped early
+        c = n = {0, 0, 0};
+        d = 0;
+        return;
+    }
+    c = color / rounds;
+    n = norm / rounds;
+    d = depth / rounds;
+}
+
+void Renderer::finishRound(Estimate &e, const Vector3f &color, const Vector3f &norm,
+                           float depth) const
+{
+    e.color += color;
+    e.norm += norm;
+    e.depth += depth;
+
+    // Welford's update; the samples are independent estimates of the pixel,
+    // so m2 / (n (n - 1)) is the squared standard error of their mean
+    Vector3f d = color - e.mean;
+    e.rounds++;
+    e.mean += d / e.rounds;
+    e.m2 += d * (color - e.mean);
+
+    if (e.rounds >= maxRounds())
+    {
+        e.done = true;
+        return;
+    }
+    if (!_args.adaptive || e.rounds < minRounds)
+        return;
+    float limit = _args.threshold * _args.threshold * e.rounds * (e.rounds - 1);
+    e.done = e.m2[0] <= limit && e.m2[1] <= limit && e.m2[2] <= limit;
+}
+
+void Renderer::accumulate(const Vector3f &sampleColor, const Hit &h, Vector3f &color,
+                          Vector3f &norm, float &depth) const
+{
+    color += sampleColor;
+    if (_normals)
+        norm += (h.getNormal() + 1.0f) / 2.0f;
+    float range = (_args.depth_max - _args.depth_min);
+    if (_depth && range)
+        depth += (h.t - _args.depth_min) / range;
+}
+
+void Renderer::splat(SplatBuffer *splats, const Sample &s, const Vector3f &sampleColor,
+                     const Hit &h) const
+{
+    Vector3f color, norm;
+    float depth = 0;
+    accumulate(sampleColor, h, color, norm, depth);
+    splats->add(*_filter, s.px, s.py, color, norm, depth);
+}
+
+// Turns the sums over a pixel's samples into averages.
+static void resolve(int samples, Vector3f &color, Vector3f &norm, float &depth)
+{
+    color = color / samples;
+    norm = norm / samples;
+    depth = depth / samples;
+}
+
+void Renderer::renderPixel(int x, int y, Vector3f &color, Vector3f &norm,
+                           float &depth, SplatBuffer *splats) const
+{
+    int n = samplesPerPixel();
+    Camera *cam = _scene.getCamera();
+
+    color = norm = {0, 0, 0};
+    depth = 0;
+    For(k, n)
+    {
+        Sample s = pixelSample(x, y, k);
+        Ray r = cam->generateRay(Vector2f(s.ndcx, s.ndcy));
+        Hit h;
+        Vector3f c = traceCamera(r, cam->getTMin(), h);
+        if (splats)
+            splat(splats, s, c, h);
+        else
+            accumulate(c, h, color, norm, depth);
+    }
+    resolve(n, color, norm, depth);
+    Stats::local().cameraSamples += n;
+    Stats::local().fixedSamples += n;
+}
+
+void Renderer::sampleRound(int x, int y, Estimate &e, SplatBuffer *splats) const
+{
+    Camera *cam = _scene.getCamera();
+    Sample s = pixelSample(x, y, e.rounds);
+    Ray r = cam->generateRay(Vector2f(s.ndcx, s.ndcy));
+    Hit h;
+    Vector3f c = traceCamera(r, cam->getTMin(), h);
+    if (splats)
+        splat(splats, s, c, h);
+    Vector3f rc, rn;
+    float rd = 0;
+    accumulate(c, h, rc, rn, rd);
+    finishRound(e, rc, rn, rd);
+    Stats::local().cameraSamples++;
+}
+
+void Renderer::renderAdaptive(int x, int y, Vector3f &color, Vector3f &norm,
+                              float &depth, SplatBuffer *splats) const
+{
+    Estimate e;
+    while (!e.done)
+        sampleRound(x, y, e, splats);
+    e.resolve(color, norm, depth);
+    Stats::local().fixedSamples += samplesPerPixel();
+}
+
+void Renderer::tracePacket(const RayPacket &packet, int lanes, Vector3f *colors,
+                           Hit *hits) const
+{
+    Stats::local().rays += lanes;
+    _scene.getGroup()->intersectPacket(packet, hits);
+    if (!_color)
+    {
+        For(i, lanes)
+            colors[i] = {0, 0, 0};
+        return;
+    }
+
+    // shading diverges: shadow and bounce rays go one at a time
+    For(i, lanes)
+    {
+        Ray r = packet.ray(i);
+        colors[i] = hits[i].getT() < std::numeric_limits<float>::max()
+                        ? shade(r, _args.bounces, hits[i])
+                        : background(r.getDirection());
+    }
+}
+
+void Renderer::renderPacket(int x0, int y0, int bw, int bh, Vector3f *color,
+                            Vector3f *norm, float *depth, SplatBuffer *splats) const
+{
+    int lanes = bw * bh, n = samplesPerPixel();
+    For(i, lanes)
+    {
+        color[i] = norm[i] = {0, 0, 0};
+        depth[i] = 0;
+    }
+
+    Camera *cam = _scene.getCamera();
+    RayPacket packet;
+    For(k, n)
+    {
+        Sample samples[RayPacket::max_size];
+        For(i, lanes)
+        {
+            samples[i] = pixelSample(x0 + i % bw, y0 + i / bw, k);
+            packet.set(i, cam->generateRay(Vector2f(samples[i].ndcx, samples[i].ndcy)),
+                       cam->getTMin());
         }
+        packet.finish(lanes);
 
-    if (_args.output_file.size())
-        image.savePNG(_args.output_file);
-    if (_args.depth_file.size())
-        dimage.savePNG(_args.depth_file);
-    if (_args.normals_file.size())
-        nimage.savePNG(_args.normals_file);
+        Hit hits[RayPacket::max_size];
+        Vector3f c[RayPacket::max_size];
+        tracePacket(packet, lanes, c, hits);
+        For(i, lanes)
+            if (splats)
+                splat(splats, samples[i], c[i], hits[i]);
+            else
+                accumulate(c[i], hits[i], color[i], norm[i], depth[i]);
+    }
+    For(i, lanes)
+        resolve(n, color[i], norm[i], depth[i]);
+    Stats::local().cameraSamples += (long long)n * lanes;
+    Stats::local().fixedSamples += (long long)n * lanes;
+}
+
+int Renderer::sampleRoundPacket(int x0, int y0, int bw, int bh, Estimate *const *est,
+                                SplatBuffer *splats) const
+{
+    // the packet holds the pixels that still need samples
+    Camera *cam = _scene.getCamera();
+    Sample samples[RayPacket::max_size];
+    int active[RayPacket::max_size];
+    int m = 0;
+    For(i, bw * bh)
+        if (!est[i]->done)
+        {
+            samples[m] = pixelSample(x0 + i % bw, y0 + i / bw, est[i]->rounds);
+            active[m++] = i;
+        }
+    if (!m)
+        return 0;
+
+    RayPacket packet;
+    For(j, m)
+        packet.set(j, cam->generateRay(Vector2f(samples[j].ndcx, samples[j].ndcy)),
+                   cam->getTMin());
+    packet.finish(m);
+
+    Hit hits[RayPacket::max_size];
+    Vector3f c[RayPacket::max_size];
+    tracePacket(packet, m, c, hits);
+    For(j, m)
+    {
+        if (splats)
+            splat(splats, samples[j], c[j], hits[j]);
+        Vector3f rc, rn;
+        float rd = 0;
+        accumulate(c[j], hits[j], rc, rn, rd);
+        finishRound(*est[active[j]], rc, rn, rd);
+    }
+    Stats::local().cameraSamples += m;
+    return m;
+}
+
+void Renderer::renderAdaptivePacket(int x0, int y0, int bw, int bh, Vector3f *color,
+                                    Vector3f *norm, float *depth, SplatBuffer *splats) const
+{
+    int lanes = bw * bh;
+    Estimate est[RayPacket::max_size];
+    Estimate *lane[RayPacket::max_size];
+    For(i, lanes)
+        lane[i] = &est[i];
+    while (sampleRoundPacket(x0, y0, bw, bh, lane, splats))
+        ;
+    For(i, lanes)
+        est[i].resolve(color[i], norm[i], depth[i]);
+    Stats::local().fixedSamples += (long long)lanes * samplesPerPixel();
 }
 #undef For
 
@@ -93,9 +723,32 @@ static Ray refl(const Ray &r, const Hit &h)
 
 Vector3f Renderer::traceRay(const Ray &r, float tmin, int bounces, Hit &h) const
 {
+    Stats::local().rays++;
     if (!_scene.getGroup()->intersect(r, tmin, h))
-        return _scene.getBackgroundColor(r.getDirection());
+        return background(r.getDirection());
+    return shade(r, bounces, h);
+}
 
+Vector3f Renderer::background(const Vector3f &dir) const
+{
+    const CubeMap *cubemap = _scene.getCubeMap();
+    if (cubemap && _args.env_lod >= 0)
+        return cubemap->getTexelLod(dir, _args.env_lod);
+    return _scene.getBackgroundColor(dir, _pixelAngle);
+}
+
+Vector3f Renderer::traceCamera(const Ray &r, float tmin, Hit &h) const
+{
+    if (_color)
+        return traceRay(r, tmin, _args.bounces, h);
+    Stats::local().rays++;
+    _scene.getGroup()->intersect(r, tmin, h);
+    return {0, 0, 0};
+}
+
+Vector3f Renderer::shade(const Ray &r, int bounces, const Hit &h) const
+{
+    TraceStats &stats = Stats::local();
     Material *m = h.getMaterial();
 
     Vector3f p = r.pointAtParameter(h.getT());
@@ -106,8 +759,13 @@ Vector3f Renderer::traceRay(const Ray &r, float tmin, int bounces, Hit &h) const
         float dist;
         light->getIllumination(p, tolight, ind, dist);
 
-        Hit sh;
-        if (_args.shadows && _scene.getGroup()->intersect({p, tolight}, 0.0001f, sh) && sh.getT() < dist)
+        if (_args.shadows)
+        {
+            stats.rays++;
+            stats.shadowRays++;
+        }
+        // any blocker closer than the light will do: no closest-hit search
+        if (_args.shadows && _scene.getGroup()->occluded({p, tolight}, 0.0001f, dist))
             continue;
         I += m->shade(r, h, tolight, ind);
     }
@@ -116,42 +774,3 @@ Vector3f Renderer::traceRay(const Ray &r, float tmin, int bounces, Hit &h) const
         I += traceRay(refl(r, h), 0.0001f, bounces - 1, rh) * m->getSpecularColor();
     return I;
 }
-
-/**
- * The following code is a refactored version of the code above.
- * It is even harder to read and less efficient.
- * The only advantage is that it is shorter.
- */
-/*
-For(y, h) For(x, w)
-{
-    Vector3f color = {0, 0, 0}, norm = {0, 0, 0};
-    float depth = 0;
-    int scale = _args.filter ? scale : 1;
-    float sum = _args.filter ? sum : samples;
-    For(i, scale) For(j, scale)
-    {
-        Vector3f color2 = {0, 0, 0}, norm2 = {0, 0, 0};
-        float depth2 = 0;
-        For(_, samples)
-        {
-            float ndcy = 2 * ((y * scale + i + jitter()) / (h * scale - 1.0f)) - 1.0f;
-            float ndcx = 2 * ((x * scale + j + jitter()) / (w * scale - 1.0f)) - 1.0f;
-            Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
-            Hit h;
-            color2 += traceRay(r, cam->getTMin(), _args.bounces, h);
-            norm2 += (h.getNormal() + 1.0f) / 2.0f;
-            float range = (_args.depth_max - _args.depth_min);
-            if (range)
-                depth2 += (h.t - _args.depth_min) / range;
-        }
-        color += _args.filter ? color2 * weight[i][j] / samples : color2 / samples;
-        norm += _args.filter ? norm2 * weight[i][j] / samples : norm2 / samples;
-        depth += _args.filter ? depth2 * weight[i][j] / samples : depth2 / samples;
-    }
-    image.setPixel(x, y, color / sum);
-    nimage.setPixel(x, y, norm / sum);
-    dimage.setPixel(x, y, Vector3f(depth / sum));
-}
-
-*/
\ No newline at end of file
@@ -1,27 +1,177 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <chrono>
+#include <functional>
 #include <string>
 
 #include "SceneParser.h"
 #include "ArgParser.h"
+#include "Filter.h"
+#include "Image.h"
+#include "Sampler.h"
 
 class Hit;
+class SplatBuffer;
 class Vector3f;
 class Ray;
+class RayPacket;
 
 class Renderer
 {
   public:
     // Instantiates a renderer for the given scene.
     Renderer(const ArgParser &args);
+    ~Renderer();
     void Render();
   private:
+    // The output images of a render, or of a band of rows of it. Only the
+    // images whose files were asked for have pixels (half floats with
+    // -half_film); the others stay 0 x 0.
+    struct Film
+    {
+        int width, height;
+        Image color, normals, depth;
+
+        Film(const ArgParser &args, int width, int height);
+
+        // Stores what was asked for of pixel (x, y).
+        void set(int x, int y, const Vector3f &color, const Vector3f &norm, float depth);
+
+        // Sets every row y of the film to row y0 + y of splats.
+        void set(const SplatBuffer &splats, int y0);
+    };
+
+    // Rows a pixel filter spreads samples beyond their own pixel.
+    int filterMargin() const;
+
+    // Runs body(x0, y0, x1, y1, tileSplats) for the tiles of rows
+    // [y0, y1) on the workers. With a pixel filter every tile splats into a
+    // SplatBuffer of its own that also covers the filter margin around it,
+    // and the tiles are added to splats in a fixed order once they are all
+    // done; splats must cover the rows and their margin. Without a filter
+    // splats and tileSplats are nullptr.
+    void forTiles(int y0, int y1, SplatBuffer *splats,
+                  const std::function<void(int, int, int, int, SplatBuffer *)> &body) const;
+
+    // Renders rows [y0, y1): with a pixel filter into splats (see
+    // forTiles()), otherwise into film, whose row 0 holds row y0.
+    void renderRows(int y0, int y1, Film *film, SplatBuffer *splats) const;
+
+    // Renders the image band by band and hands each band to a PngWriter
+    // per output file (see ArgParser::stream).
+    void renderStreaming(std::chrono::steady_clock::time_point start) const;
+
+    // Renders pass after pass of samples over the whole image into film,
+    // until every pixel has its samples, the time budget runs out or
+    // SIGTERM / SIGINT arrives. Writes the images every
+    // ArgParser::checkpoint seconds along the way.
+    void renderProgressive(Film &film) const;
+
+    // Reports the stats for a render begun at start and saves the images.
+    void finish(std::chrono::steady_clock::time_point start, const Film &film) const;
+    void save(const Film &film) const;
+
+    // One camera sample: where it lands in NDC and on the film, in pixels.
+    struct Sample
+    {
+        float ndcx, ndcy;
+        float px, py;
+    };
+
+    // Camera samples of a pixel without adaptive sampling.
+    int samplesPerPixel() const;
+
+    // Sample `index` of pixel (x, y), jittered by the sampler.
+    Sample pixelSample(int x, int y, int index) const;
+
+    // Running estimate of a pixel under adaptive sampling, which takes one
+    // sample per round.
+    struct Estimate
+    {
+        Vector3f color, norm;       // sums over all rounds
+        float depth;
+        Vector3f mean, m2;          // running variance of the round colors
+        int rounds;
+        bool done;
+
+        Estimate() : depth(0), rounds(0), done(false) {}
+
+        // the averages so far; black before the first round
+        void resolve(Vector3f &color, Vector3f &norm, float &depth) const;
+    };
+
+    // Rounds a pixel takes at most: all of its samples without adaptive
+    // sampling.
+    int maxRounds() const;
+
+    // Traces the next round of pixel (x, y) into e, splatting it into
+    // splats as well with a pixel filter.
+    void sampleRound(int x, int y, Estimate &e, SplatBuffer *splats) const;
+
+    // The same for the bw x bh pixels at (x0, y0), est[i] belonging to
+    // pixel i of the block in row order, as one packet. Pixels that are
+    // done are left out; returns how many took a round.
+    int sampleRoundPacket(int x0, int y0, int bw, int bh, Estimate *const *est,
+                          SplatBuffer *splats) const;
+
+    // Adds a round's sums to e and decides whether e is done.
+    void finishRound(Estimate &e, const Vector3f &color, const Vector3f &norm,
+                     float depth) const;
+
+    // Computes the color, normal and depth values of pixel (x, y), or
+    // with a pixel filter splats its samples into splats instead.
+    // Only reads shared state, so pixels may be rendered concurrently.
+    void renderPixel(int x, int y, Vector3f &color, Vector3f &norm,
+                     float &depth, SplatBuffer *splats) const;
+
+    // renderPixel() for the bw x bh pixels at (x0, y0), whose camera rays
+    // are traced as one packet per sample. Results are stored row by row.
+    void renderPacket(int x0, int y0, int bw, int bh, Vector3f *color,
+                      Vector3f *norm, float *depth, SplatBuffer *splats) const;
+
+    // The same two with adaptive sampling: every pixel takes rounds of
+    // samples until its color has settled (see ArgParser::adaptive).
+    void renderAdaptive(int x, int y, Vector3f &color, Vector3f &norm,
+                        float &depth, SplatBuffer *splats) const;
+    void renderAdaptivePacket(int x0, int y0, int bw, int bh, Vector3f *color,
+                              Vector3f *norm, float *depth, SplatBuffer *splats) const;
+
+    // Traces the first `lanes` rays of packet and shades their hits.
+    void tracePacket(const RayPacket &packet, int lanes, Vector3f *colors,
+                     Hit *hits) const;
+
+    // traceRay() for a camera ray. Without a color image only the first
+    // hit is found: no lighting, shadow or bounce rays.
+    Vector3f traceCamera(const Ray &ray, float tmin, Hit &hit) const;
+
+    // Adds one sample's contributions to a pixel's sums.
+    void accumulate(const Vector3f &sampleColor, const Hit &hit, Vector3f &color,
+                    Vector3f &norm, float &depth) const;
+
+    // Splats one sample into splats through the pixel filter.
+    void splat(SplatBuffer *splats, const Sample &s, const Vector3f &sampleColor,
+               const Hit &hit) const;
+
     Vector3f traceRay(const Ray &ray, float tmin, int bounces, 
                       Hit &hit) const;
 
+    // The environment seen along dir. Cube maps are prefiltered over the
+    // angle of a pixel, which holds for camera rays and the mirror bounces
+    // off flat surfaces (curved ones spread it further), or read at the
+    // fixed ArgParser::env_lod.
+    Vector3f background(const Vector3f &dir) const;
+
+    // Shades a hit found for ray, tracing its shadow and bounce rays.
+    Vector3f shade(const Ray &ray, int bounces, const Hit &hit) const;
+
     ArgParser _args;
+    std::chrono::steady_clock::time_point _created; // start of the time budget
     SceneParser _scene;
+    Sampler *_sampler;
+    Filter *_filter;               // nullptr without -filter
+    bool _color, _normals, _depth; // the images asked for
+    float _pixelAngle;             // see background()
 };
 
 #endif // RENDERER_H
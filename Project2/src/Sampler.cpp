@@ -0,0 +1,192 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// 32-bit integer mixer (lowbias32)
+uint32_t
+mix(uint32_t s)
+{
+    s ^= s >> 16;
+    s *= 0x7feb352du;
+    s ^= s >> 15;
+    s *= 0x846ca68bu;
+    s ^= s >> 16;
+    return s;
+}
+
+uint32_t
+combine(uint32_t seed, uint32_t v)
+{
+    return mix(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+// top 24 bits as a float in [0, 1)
+float
+unit(uint32_t bits)
+{
+    return (bits >> 8) * (1.0f / (1 << 24));
+}
+
+uint32_t
+reverseBits(uint32_t x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Kensler's hashed permutation of [0, n), "Correlated Multi-Jittered
+// Sampling" (2013): cycle-walks a bijection on the next power of two.
+uint32_t
+permute(uint32_t i, uint32_t n, uint32_t seed)
+{
+    uint32_t w = n - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= seed;
+        i *= 0xe170893du;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fu;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= n);
+    return i;
+}
+
+float
+radicalInverse(uint32_t i, uint32_t base)
+{
+    float inv = 1.0f / base, f = inv, r = 0;
+    for (; i; i /= base, f *= inv) {
+        r += (i % base) * f;
+    }
+    return r;
+}
+
+// Owen scrambling as a hash on the bit-reversed value: flipping a bit
+// only depends on the bits above it
+uint32_t
+nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+// Sobol dimensions 0 (van der Corput) and 1, as 32-bit fractions
+uint32_t
+sobol(uint32_t index, int dim)
+{
+    uint32_t x = 0, v = 0x80000000u;
+    for (; index; index >>= 1) {
+        if (index & 1) {
+            x ^= v;
+        }
+        v = dim ? v ^ (v >> 1) : v >> 1;
+    }
+    return x;
+}
+
+float
+wrap(float x)
+{
+    return x < 1 ? x : x - 1;
+}
+
+// x clamped to the largest float below 1, for sums that can round up to 1
+float
+belowOne(float x)
+{
+    return std::min(x, 1.0f - std::numeric_limits<float>::epsilon() / 2);
+}
+}
+
+Sampler *
+Sampler::create(const std::string &name, int count)
+{
+    if (name == "independent") {
+        return new IndependentSampler();
+    } else if (name == "stratified") {
+        return new StratifiedSampler(count);
+    } else if (name == "halton") {
+        return new HaltonSampler();
+    } else if (name == "sobol") {
+        return new SobolSampler();
+    }
+    return nullptr;
+}
+
+uint32_t
+Sampler::pixelSeed(int x, int y)
+{
+    return mix((uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u);
+}
+
+Vector2f
+IndependentSampler::sample(int x, int y, int index) const
+{
+    uint32_t h = combine(pixelSeed(x, y), (uint32_t)index);
+    return Vector2f(unit(h), unit(mix(h)));
+}
+
+StratifiedSampler::StratifiedSampler(int count)
+{
+    // the squarest grid of at most count cells
+    _nx = std::max(1, (int)std::sqrt((float)count));
+    _ny = std::max(1, count / _nx);
+}
+
+Vector2f
+StratifiedSampler::sample(int x, int y, int index) const
+{
+    uint32_t cells = _nx * _ny, pass = index / cells;
+    uint32_t seed = combine(pixelSeed(x, y), pass);
+    uint32_t cell = permute(index % cells, cells, seed);
+    uint32_t h = combine(seed, cell);
+    return Vector2f(belowOne((cell % _nx + unit(h)) / _nx),
+                    belowOne((cell / _nx + unit(mix(h))) / _ny));
+}
+
+Vector2f
+HaltonSampler::sample(int x, int y, int index) const
+{
+    uint32_t h = pixelSeed(x, y);
+    return Vector2f(wrap(radicalInverse(index, 2) + unit(h)),
+                    wrap(radicalInverse(index, 3) + unit(mix(h))));
+}
+
+Vector2f
+SobolSampler::sample(int x, int y, int index) const
+{
+    uint32_t seed = pixelSeed(x, y);
+    uint32_t i = nestedUniformScramble((uint32_t)index, seed);
+    return Vector2f(unit(nestedUniformScramble(sobol(i, 0), combine(seed, 1))),
+                    unit(nestedUniformScramble(sobol(i, 1), combine(seed, 2))));
+}
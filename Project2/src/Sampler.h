@@ -0,0 +1,69 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <Vector2f.h>
+
+#include <cstdint>
+#include <string>
+
+// Where the jittered camera samples of a pixel go. A sample is a pure
+// function of its pixel and index (no generator state), so a pixel gets the
+// same samples whichever thread renders it and in whatever order, and
+// adaptive sampling can ask for more of them at any time.
+class Sampler
+{
+  public:
+    virtual ~Sampler() { }
+
+    // Maps "independent", "stratified", "halton" or "sobol" to a new
+    // sampler for `count` samples per pixel; nullptr for anything else.
+    static Sampler *create(const std::string &name, int count);
+
+    // Sample `index` of pixel (x, y), in [0, 1)^2.
+    virtual Vector2f sample(int x, int y, int index) const = 0;
+
+  protected:
+    // A well mixed seed per pixel, the source of all per-pixel
+    // decorrelation (random numbers, scrambles, rotations).
+    static uint32_t pixelSeed(int x, int y);
+};
+
+// White noise: every sample on its own.
+class IndependentSampler : public Sampler
+{
+  public:
+    virtual Vector2f sample(int x, int y, int index) const override;
+};
+
+// The pixel cut into about `count` cells, one jittered sample in each,
+// visited in a per-pixel random order so that any prefix of the samples
+// is spread out as well. Samples past count start another pass.
+class StratifiedSampler : public Sampler
+{
+  public:
+    StratifiedSampler(int count);
+
+    virtual Vector2f sample(int x, int y, int index) const override;
+
+  private:
+    int _nx, _ny;
+};
+
+// The Halton sequence in bases 2 and 3, shifted by a per-pixel random
+// offset (Cranley-Patterson rotation).
+class HaltonSampler : public Sampler
+{
+  public:
+    virtual Vector2f sample(int x, int y, int index) const override;
+};
+
+// The first two Sobol dimensions with a per-pixel nested uniform (Owen)
+// scramble and shuffle, after Burley, "Practical Hash-based Owen
+// Scrambling" (2020). Every power of two prefix is stratified.
+class SobolSampler : public Sampler
+{
+  public:
+    virtual Vector2f sample(int x, int y, int index) const override;
+};
+
+#endif // SAMPLER_H
@@ -24,7 +24,10 @@ _PostError(const std::string &msg)
     exit(1);
 }
 
-SceneParser::SceneParser(const std::string &filename) :
+SceneParser::SceneParser(const std::string &filename,
+                         const std::string &accel,
+                         int threads,
+                         bool meshCache) :
     _file(NULL),
     _camera(NULL),
     _background_color(0.5, 0.5, 0.5),
@@ -33,11 +36,17 @@ SceneParser::SceneParser(const std::string &filename) :
     _num_materials(0),
     _current_material(NULL),
     _group(NULL),
-    _cubemap(NULL)
+    _cubemap(NULL),
+    _threads(threads),
+    _meshCache(meshCache)
 {
     // parse the file
     assert(!filename.empty());
 
+    if (!Mesh::parseAccel(accel, _accel)) {
+        _PostError("ERROR: Unknown mesh accelerator '" + accel + "'\n");
+    }
+
     if (filename.size() <= 4) {
         _PostError("ERROR: Wrong file name extension\n");
     }
@@ -85,7 +94,13 @@ SceneParser::~SceneParser()
         delete light;
     }
     for (auto *object : _objects) {
-        delete object;
+        // meshes may be placed more than once; they go below
+        if (!dynamic_cast<Mesh *>(object)) {
+            delete object;
+        }
+    }
+    for (auto &mesh : _meshes) {
+        delete mesh.second;
     }
     delete _cubemap;
 }
@@ -171,7 +186,7 @@ SceneParser::parseCubeMap()
 {
     char token[MAX_PARSER_TOKEN_LENGTH];
     getToken(token);
-    return new CubeMap(_basepath + token);
+    return new CubeMap(_basepath + token, _threads);
 }
 
 // ====================================================================
@@ -371,6 +386,9 @@ SceneParser::parseGroup()
     }
     getToken(token); assert(!strcmp(token, "}"));
 
+    // every member is known now: build the group's acceleration structure
+    answer->buildBvh();
+
     // return the group
     return answer;
 }
@@ -428,21 +446,42 @@ SceneParser::parseTriangle()
     return new Triangle(v0, v1, v2, n, n, n, _current_material);
 }
 
-Mesh *
+Object3D *
 SceneParser::parseTriangleMesh() 
 {
     char token[MAX_PARSER_TOKEN_LENGTH];
     char filename[MAX_PARSER_TOKEN_LENGTH];
-    // get the filename
+    Mesh::Accel accel = _accel;
+    // get the filename and the optional accelerator
     getToken(token); assert(!strcmp(token, "{"));
     getToken(token); assert(!strcmp(token, "obj_file"));
     getToken(filename); 
-    getToken(token); assert(!strcmp(token, "}"));
+    while (true) {
+        getToken(token);
+        if (!strcmp(token, "accel")) {
+            getToken(token);
+            if (!Mesh::parseAccel(token, accel)) {
+                _PostError(std::string("Unknown accel in TriangleMesh: '") + token + "'\n");
+            }
+        } else {
+            assert(!strcmp(token, "}"));
+            break;
+        }
+    }
     const char *ext = &filename[strlen(filename)-4];
     assert(!strcmp(ext,".obj"));
-    Mesh *answer = new Mesh(_basepath + filename,_current_material);
 
-    return answer;
+    // A file already loaded with the same accelerator is shared: as it is
+    // when the material matches, else as an instance with this material.
+    Mesh *&mesh = _meshes[std::make_pair(_basepath + filename, accel)];
+    if (!mesh) {
+        mesh = new Mesh(_basepath + filename,_current_material, accel, _threads, _meshCache);
+        return mesh;
+    }
+    if (mesh->getMaterial() == _current_material) {
+        return mesh;
+    }
+    return new MeshInstance(mesh, _current_material);
 }
 
 Transform *
@@ -501,6 +540,20 @@ SceneParser::parseTransform()
 
     assert(object != NULL);
     getToken(token); assert(!strcmp(token, "}"));
+
+    // Transform only keeps the affine part of its matrix
+    if (matrix(3, 0) != 0 || matrix(3, 1) != 0 || matrix(3, 2) != 0 ||
+        matrix(3, 3) != 1) {
+        _PostError("Transform matrix must be affine, with a last row of 0 0 0 1\n");
+    }
+
+    // Collapse directly nested Transforms into one; the inner one was
+    // already collapsed when it was parsed, and its matrix applies first.
+    if (Transform *inner = dynamic_cast<Transform *>(object)) {
+        matrix = matrix * inner->getMatrix();
+        object = inner->getObject();
+        delete inner;
+    }
     return new Transform(matrix, object);
 }
 
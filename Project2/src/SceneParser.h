@@ -2,6 +2,9 @@
 #define SCENE_PARSER_H
 
 #include <cassert>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 #include <vecmath.h>
 
@@ -18,16 +21,30 @@
 class SceneParser
 {
   public:
-    SceneParser(const std::string &filename);
+    // accel names the mesh acceleration structure used when a TriangleMesh
+    // does not pick one itself ("none", "octree" or "bvh"); meshes load on
+    // up to `threads` workers (0 for all cores), through their MeshCache
+    // if meshCache is set
+    SceneParser(const std::string &filename,
+                const std::string &accel = "octree",
+                int threads = 0,
+                bool meshCache = true);
     ~SceneParser();
 
     Camera * getCamera() const {
         return _camera;
     }
 
-    Vector3f getBackgroundColor(const Vector3f &dir) const {
+    // nullptr without a cubeMap in the Background
+    const CubeMap * getCubeMap() const {
+        return _cubemap;
+    }
+
+    // The environment in direction dir, prefiltered over a cone of
+    // `footprint` radians with a cube map (see CubeMap::getTexel).
+    Vector3f getBackgroundColor(const Vector3f &dir, float footprint = 0) const {
         if (_cubemap) {
-            return _cubemap->getTexel(dir);
+            return _cubemap->getTexel(dir, footprint);
         } else {
             return _background_color;
         }
@@ -75,7 +92,7 @@ class SceneParser
     Sphere * parseSphere();
     Plane * parsePlane();
     Triangle * parseTriangle();
-    Mesh * parseTriangleMesh();
+    Object3D * parseTriangleMesh();
     Transform * parseTransform();
     CubeMap * parseCubeMap();
 
@@ -97,6 +114,11 @@ class SceneParser
     Material * _current_material;
     Group * _group;
     CubeMap * _cubemap;
+    Mesh::Accel _accel;
+    int _threads;
+    bool _meshCache;
+    // every mesh file loaded so far, by path and accelerator; owns them
+    std::map<std::pair<std::string, Mesh::Accel>, Mesh*> _meshes;
 };
 
 #endif // SCENE_PARSER_H
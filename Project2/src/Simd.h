@@ -0,0 +1,270 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrappers over the widest float vector the target was compiled for:
+// AVX (8 lanes), SSE2 (4 lanes) or a plain-array fallback (4 lanes). The
+// kernels are written once against vfloat / vbool and SIMD_WIDTH.
+//
+// Every operation is the IEEE single precision operation of the scalar code,
+// lane by lane, so a kernel written in the same order as its scalar twin
+// produces bit-identical results.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Half.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+#else
+#define SIMD_WIDTH 4
+#define SIMD_SCALAR
+#endif
+
+#if defined(__AVX__)
+
+struct vbool
+{
+    __m256 m;
+};
+
+struct vfloat
+{
+    __m256 v;
+
+    vfloat() {}
+    vfloat(__m256 x) : v(x) {}
+    vfloat(float x) : v(_mm256_set1_ps(x)) {}
+
+    static vfloat load(const float *p) {
+        return _mm256_loadu_ps(p);
+    }
+    void store(float *p) const {
+        _mm256_storeu_ps(p, v);
+    }
+};
+
+// The lanes rounded toward zero as a cast to int does, then clamped to
+// [0, 255], to SIMD_WIDTH bytes at p. NaNs and lanes out of int range
+// become 0, as cvttps makes them INT_MIN.
+inline void storeBytes(vfloat a, uint8_t *p) {
+    __m256i i = _mm256_cvttps_epi32(a.v);
+    __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extractf128_si256(i, 1));
+    _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(w, w));
+}
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a.v, b.v); }
+inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a.v); }
+
+inline vbool operator<(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline vbool operator>(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline vbool operator<=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline vbool operator>=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline vbool operator==(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+inline vbool operator&(vbool a, vbool b) { return { _mm256_and_ps(a.m, b.m) }; }
+inline vbool operator|(vbool a, vbool b) { return { _mm256_or_ps(a.m, b.m) }; }
+inline vbool andNot(vbool a, vbool b) { return { _mm256_andnot_ps(b.m, a.m) }; } // a & ~b
+inline vbool operator!(vbool a) { return { _mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+
+// one bit per lane, lane 0 in bit 0
+inline int movemask(vbool a) { return _mm256_movemask_ps(a.m); }
+inline vfloat select(vbool m, vfloat a, vfloat b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+
+#elif !defined(SIMD_SCALAR)
+
+struct vbool
+{
+    __m128 m;
+};
+
+struct vfloat
+{
+    __m128 v;
+
+    vfloat() {}
+    vfloat(__m128 x) : v(x) {}
+    vfloat(float x) : v(_mm_set1_ps(x)) {}
+
+    static vfloat load(const float *p) {
+        return _mm_loadu_ps(p);
+    }
+    void store(float *p) const {
+        _mm_storeu_ps(p, v);
+    }
+};
+
+inline void storeBytes(vfloat a, uint8_t *p) {
+    __m128i w = _mm_packs_epi32(_mm_cvttps_epi32(a.v), _mm_setzero_si128());
+    int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+    memcpy(p, &bytes, 4);
+}
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a.v, b.v); }
+inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a.v); }
+
+inline vbool operator<(vfloat a, vfloat b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline vbool operator>(vfloat a, vfloat b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline vbool operator<=(vfloat a, vfloat b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline vbool operator>=(vfloat a, vfloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline vbool operator==(vfloat a, vfloat b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+inline vbool operator&(vbool a, vbool b) { return { _mm_and_ps(a.m, b.m) }; }
+inline vbool operator|(vbool a, vbool b) { return { _mm_or_ps(a.m, b.m) }; }
+inline vbool andNot(vbool a, vbool b) { return { _mm_andnot_ps(b.m, a.m) }; } // a & ~b
+inline vbool operator!(vbool a) { return { _mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1))) }; }
+
+inline int movemask(vbool a) { return _mm_movemask_ps(a.m); }
+inline vfloat select(vbool m, vfloat a, vfloat b) {
+    return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v));
+}
+
+#else
+
+// Portable fallback: the same interface over plain arrays. The loops are
+// short and fixed-length, so compilers may still vectorize them.
+struct vbool
+{
+    bool m[SIMD_WIDTH];
+};
+
+struct vfloat
+{
+    float v[SIMD_WIDTH];
+
+    vfloat() {}
+    vfloat(float x) {
+        for (int i = 0; i < SIMD_WIDTH; ++i) v[i] = x;
+    }
+
+    static vfloat load(const float *p) {
+        vfloat r;
+        for (int i = 0; i < SIMD_WIDTH; ++i) r.v[i] = p[i];
+        return r;
+    }
+    void store(float *p) const {
+        for (int i = 0; i < SIMD_WIDTH; ++i) p[i] = v[i];
+    }
+};
+
+inline void storeBytes(vfloat a, uint8_t *p) {
+    for (int i = 0; i < SIMD_WIDTH; ++i) {
+        float x = a.v[i];
+        p[i] = x >= 255.0f && x < 2147483648.0f ? 255 : x >= 1.0f ? (uint8_t)x : 0;
+    }
+}
+
+#define SIMD_LANEWISE(type, expr) \
+    type r; \
+    for (int i = 0; i < SIMD_WIDTH; ++i) expr; \
+    return r
+
+inline vfloat operator+(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] + b.v[i]); }
+inline vfloat operator-(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] - b.v[i]); }
+inline vfloat operator*(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] * b.v[i]); }
+inline vfloat operator/(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] / b.v[i]); }
+inline vfloat operator-(vfloat a) { SIMD_LANEWISE(vfloat, r.v[i] = -a.v[i]); }
+// operand order matches minps / maxps: the second operand wins on NaN
+inline vfloat vmin(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+inline vfloat vmax(vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline vfloat vsqrt(vfloat a) { SIMD_LANEWISE(vfloat, r.v[i] = std::sqrt(a.v[i])); }
+
+inline vbool operator<(vfloat a, vfloat b) { SIMD_LANEWISE(vbool, r.m[i] = a.v[i] < b.v[i]); }
+inline vbool operator>(vfloat a, vfloat b) { SIMD_LANEWISE(vbool, r.m[i] = a.v[i] > b.v[i]); }
+inline vbool operator<=(vfloat a, vfloat b) { SIMD_LANEWISE(vbool, r.m[i] = a.v[i] <= b.v[i]); }
+inline vbool operator>=(vfloat a, vfloat b) { SIMD_LANEWISE(vbool, r.m[i] = a.v[i] >= b.v[i]); }
+inline vbool operator==(vfloat a, vfloat b) { SIMD_LANEWISE(vbool, r.m[i] = a.v[i] == b.v[i]); }
+inline vbool operator&(vbool a, vbool b) { SIMD_LANEWISE(vbool, r.m[i] = a.m[i] && b.m[i]); }
+inline vbool operator|(vbool a, vbool b) { SIMD_LANEWISE(vbool, r.m[i] = a.m[i] || b.m[i]); }
+inline vbool andNot(vbool a, vbool b) { SIMD_LANEWISE(vbool, r.m[i] = a.m[i] && !b.m[i]); }
+inline vbool operator!(vbool a) { SIMD_LANEWISE(vbool, r.m[i] = !a.m[i]); }
+
+inline int movemask(vbool a) {
+    int bits = 0;
+    for (int i = 0; i < SIMD_WIDTH; ++i) bits |= a.m[i] << i;
+    return bits;
+}
+inline vfloat select(vbool m, vfloat a, vfloat b) { SIMD_LANEWISE(vfloat, r.v[i] = m.m[i] ? a.v[i] : b.v[i]); }
+
+#undef SIMD_LANEWISE
+
+#endif
+
+#if !defined(SIMD_SCALAR) && !defined(__F16C__)
+// The half floats in the low 16 bits of the lanes of h as floats, exactly:
+// rebias the exponent, once more for infinities and NaNs, and let the FPU
+// normalize subnormals.
+inline __m128 halfToFloat4(__m128i h) {
+    const __m128i exponentMask = _mm_set1_epi32(0x0f800000);
+    __m128i o = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+    __m128i e = _mm_and_si128(o, exponentMask);
+    o = _mm_add_epi32(o, _mm_set1_epi32(112 << 23));
+    o = _mm_add_epi32(o, _mm_and_si128(_mm_cmpeq_epi32(e, exponentMask),
+                                       _mm_set1_epi32(112 << 23)));
+    __m128 sub = _mm_castsi128_ps(_mm_cmpeq_epi32(e, _mm_setzero_si128()));
+    __m128 normalized = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))),
+                                   _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+    __m128 f = _mm_or_ps(_mm_and_ps(sub, normalized), _mm_andnot_ps(sub, _mm_castsi128_ps(o)));
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+#endif
+
+// SIMD_WIDTH half floats from p
+inline vfloat loadHalf(const uint16_t *p) {
+#if defined(__F16C__) && defined(__AVX__)
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)p));
+#elif defined(__F16C__)
+    return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)p));
+#elif defined(__AVX__)
+    __m128i h = _mm_loadu_si128((const __m128i *)p);
+    __m128 lo = halfToFloat4(_mm_unpacklo_epi16(h, _mm_setzero_si128()));
+    __m128 hi = halfToFloat4(_mm_unpackhi_epi16(h, _mm_setzero_si128()));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#elif !defined(SIMD_SCALAR)
+    return halfToFloat4(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)p),
+                                           _mm_setzero_si128()));
+#else
+    float f[SIMD_WIDTH];
+    for (int i = 0; i < SIMD_WIDTH; ++i) f[i] = halfToFloat(p[i]);
+    return vfloat::load(f);
+#endif
+}
+
+inline bool any(vbool a) { return movemask(a) != 0; }
+inline bool none(vbool a) { return movemask(a) == 0; }
+
+// three coordinates of SIMD_WIDTH points or directions
+struct vec3v
+{
+    vfloat x, y, z;
+};
+
+inline vec3v operator-(const vec3v &a, const vec3v &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+
+// same evaluation order as Vector3f::dot / Vector3f::cross
+inline vfloat vdot(const vec3v &a, const vec3v &b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline vec3v vcross(const vec3v &a, const vec3v &b) {
+    return { a.y * b.z - a.z * b.y,
+             a.z * b.x - a.x * b.z,
+             a.x * b.y - a.y * b.x };
+}
+
+#endif // SIMD_H
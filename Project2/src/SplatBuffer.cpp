@@ -0,0 +1,94 @@
+#include "SplatBuffer.h"
+
+#include "Filter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+// pixels a sample reaches along one axis; ArgParser keeps the filter
+// radius at most 8
+const int maxReach = 17;
+
+// resolve() uses all samples while their total weight is at least this
+// share of the positive weights
+const float minWeightShare = 0.5f;
+}
+
+SplatBuffer::SplatBuffer(int x0, int y0, int width, int height) :
+    _x0(x0),
+    _y0(y0),
+    _width(width),
+    _height(height),
+    _pixels((size_t)width * height)
+{
+}
+
+void
+SplatBuffer::add(const Filter &filter, float px, float py, const Vector3f &color,
+                 const Vector3f &norm, float depth)
+{
+    // the pixels X with -radius <= px - X < radius, so that a sample on the
+    // edge between two pixels of a box filter counts for one of them
+    float r = filter.radius();
+    int bx = std::max(_x0, (int)std::floor(px - r) + 1);
+    int ex = std::min(_x0 + _width, (int)std::floor(px + r) + 1);
+    int by = std::max(_y0, (int)std::floor(py - r) + 1);
+    int ey = std::min(_y0 + _height, (int)std::floor(py + r) + 1);
+    if (bx >= ex || by >= ey) {
+        return;
+    }
+    assert(ex - bx <= maxReach && ey - by <= maxReach);
+
+    float wx[maxReach], wy[maxReach];
+    for (int x = bx; x < ex; x++) {
+        wx[x - bx] = filter.evaluate(px - x);
+    }
+    for (int y = by; y < ey; y++) {
+        wy[y - by] = filter.evaluate(py - y);
+    }
+    for (int y = by; y < ey; y++) {
+        Pixel *p = &_pixels[(size_t)(y - _y0) * _width + bx - _x0];
+        for (int x = bx; x < ex; x++, p++) {
+            float w = wx[x - bx] * wy[y - by];
+            p->all.add(w, color, norm, depth);
+            if (w > 0) {
+                p->positive.add(w, color, norm, depth);
+            }
+        }
+    }
+}
+
+void
+SplatBuffer::addRow(const SplatBuffer &o, int y)
+{
+    if (y < _y0 || y >= y1() || y < o._y0 || y >= o.y1()) {
+        return;
+    }
+    int bx = std::max(_x0, o._x0), ex = std::min(_x0 + _width, o._x0 + o._width);
+    Pixel *p = &_pixels[(size_t)(y - _y0) * _width];
+    const Pixel *q = &o._pixels[(size_t)(y - o._y0) * o._width];
+    for (int x = bx; x < ex; x++) {
+        Pixel &a = p[x - _x0];
+        const Pixel &b = q[x - o._x0];
+        a.all += b.all;
+        a.positive += b.positive;
+    }
+}
+
+void
+SplatBuffer::resolve(int x, int y, Vector3f &color, Vector3f &norm, float &depth) const
+{
+    const Pixel &p = _pixels[(size_t)(y - _y0) * _width + x - _x0];
+    const Sums &s = p.all.weight >= p.positive.weight * minWeightShare ? p.all : p.positive;
+    if (!s.weight) {
+        color = norm = Vector3f(0);
+        depth = 0;
+        return;
+    }
+    color = s.color / s.weight;
+    norm = s.norm / s.weight;
+    depth = s.depth / s.weight;
+}
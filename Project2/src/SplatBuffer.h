@@ -0,0 +1,77 @@
+#ifndef SPLAT_BUFFER_H
+#define SPLAT_BUFFER_H
+
+#include "Vector3f.h"
+
+#include <vector>
+
+class Filter;
+
+// Filter-weighted sums of camera samples over a rectangle of pixels: one
+// image tile plus the margin its samples reach into, or the rows of the
+// image the tiles are merged into. Film positions are in pixels with the
+// pixel centers at whole numbers.
+class SplatBuffer
+{
+  public:
+    struct Sums
+    {
+        Vector3f color, norm;
+        float depth, weight;
+
+        Sums() : depth(0), weight(0) { }
+
+        void add(float w, const Vector3f &c, const Vector3f &n, float d) {
+            color += c * w;
+            norm += n * w;
+            depth += d * w;
+            weight += w;
+        }
+
+        Sums &operator+=(const Sums &o) {
+            color += o.color;
+            norm += o.norm;
+            depth += o.depth;
+            weight += o.weight;
+            return *this;
+        }
+    };
+
+    // The sums over all samples and over those with a positive weight,
+    // which differ only for filters with negative lobes.
+    struct Pixel
+    {
+        Sums all, positive;
+    };
+
+    // Covers pixels [x0, x0 + width) x [y0, y0 + height).
+    SplatBuffer(int x0, int y0, int width, int height);
+
+    int y0() const {
+        return _y0;
+    }
+
+    int y1() const {
+        return _y0 + _height;
+    }
+
+    // Adds a sample at film position (px, py) to the covered pixels within
+    // the filter's radius of it.
+    void add(const Filter &filter, float px, float py, const Vector3f &color,
+             const Vector3f &norm, float depth);
+
+    // Adds the sums of row y of o, where both cover it.
+    void addRow(const SplatBuffer &o, int y);
+
+    // The weighted average of pixel (x, y); black without any weight. Where
+    // negative lobes cancel most of the weight, which happens with few
+    // samples and at the image border, the positive weights alone are used
+    // so that the average cannot blow up or flip its sign.
+    void resolve(int x, int y, Vector3f &color, Vector3f &norm, float &depth) const;
+
+  private:
+    int _x0, _y0, _width, _height;
+    std::vector<Pixel> _pixels;
+};
+
+#endif // SPLAT_BUFFER_H
@@ -0,0 +1,105 @@
+#include "Stats.h"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+std::mutex registryLock;
+std::deque<TraceStats> registry; // deque: blocks never move once handed out
+}
+
+TraceStats &
+Stats::local()
+{
+    thread_local TraceStats *block = nullptr;
+    if (!block) {
+        std::lock_guard<std::mutex> guard(registryLock);
+        registry.emplace_back();
+        block = &registry.back();
+    }
+    return *block;
+}
+
+TraceStats
+Stats::total()
+{
+    std::lock_guard<std::mutex> guard(registryLock);
+    TraceStats sum;
+    for (const TraceStats &s : registry) {
+        sum.rays += s.rays;
+        sum.shadowRays += s.shadowRays;
+        sum.nodeVisits += s.nodeVisits;
+        sum.triangleTests += s.triangleTests;
+        sum.buildSeconds += s.buildSeconds;
+        sum.accelBytes += s.accelBytes;
+        sum.meshBytes += s.meshBytes;
+        sum.loadSeconds += s.loadSeconds;
+        sum.loadBytes += s.loadBytes;
+        sum.cacheHits += s.cacheHits;
+        sum.cacheMisses += s.cacheMisses;
+        sum.cameraSamples += s.cameraSamples;
+        sum.fixedSamples += s.fixedSamples;
+    }
+    return sum;
+}
+
+long long
+Stats::peakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return (long long)pmc.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;        // bytes on macOS
+#else
+    return usage.ru_maxrss * 1024LL; // KiB elsewhere
+#endif
+#endif
+}
+
+void
+Stats::report(std::ostream &os, double seconds)
+{
+    TraceStats s = total();
+    double rays = s.rays ? (double)s.rays : 1.0;
+    os << "Stats:\n";
+    os << "- mesh load: " << s.loadSeconds << " s, "
+       << (s.loadSeconds > 0 ? s.loadBytes / (1024.0 * 1024.0) / s.loadSeconds : 0.0)
+       << " MiB/s\n";
+    os << "- mesh cache: " << s.cacheHits << " hits, " << s.cacheMisses << " misses\n";
+    os << "- accel build: " << s.buildSeconds << " s, "
+       << s.accelBytes / 1024.0 << " KiB\n";
+    os << "- mesh data: " << s.meshBytes / 1024.0 << " KiB\n";
+    os << "- peak memory: " << peakMemory() / (1024.0 * 1024.0) << " MiB\n";
+    os << "- time: " << seconds << " s\n";
+    os << "- rays: " << s.rays << " (" << s.shadowRays << " shadow)\n";
+    // rays per camera sample, applied to the samples adaptive sampling
+    // skipped: an estimate of the rays it saved
+    double raysPerSample = s.cameraSamples ? (double)s.rays / s.cameraSamples : 0.0;
+    long long saved = (long long)((s.fixedSamples - s.cameraSamples) * raysPerSample);
+    os << "- camera samples: " << s.cameraSamples << " of " << s.fixedSamples << " fixed (~"
+       << (saved >= 0 ? saved : -saved) << (saved >= 0 ? " rays saved)\n" : " extra rays)\n");
+    os << "- rays/sec: " << (seconds > 0 ? s.rays / seconds : 0.0) << "\n";
+    os << "- node visits: " << s.nodeVisits
+       << " (" << s.nodeVisits / rays << " per ray)\n";
+    os << "- triangle tests: " << s.triangleTests
+       << " (" << s.triangleTests / rays << " per ray)\n";
+}
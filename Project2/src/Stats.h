@@ -0,0 +1,62 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <iosfwd>
+
+// Ray tracing counters, reported with -stats.
+//
+// Every thread counts into its own block (see local()), so the hot loops
+// only touch thread-private memory; total() sums the blocks and must only
+// be called once the parallelFor calls that counted have returned. The
+// pool workers of parallelFor keep their threads, so there is one block
+// per worker however many calls there were.
+struct TraceStats
+{
+    long long rays;          // rays handed to the scene (primary, shadow, bounce)
+    long long shadowRays;    // the any-hit share of rays
+    long long nodeVisits;    // acceleration structure nodes entered
+    long long triangleTests; // ray / triangle intersection tests
+    double buildSeconds;     // time spent building mesh accelerators
+    long long accelBytes;    // memory held by mesh accelerators
+    long long meshBytes;     // mesh vertices, normals and indices
+    double loadSeconds;      // time spent reading mesh files
+    long long loadBytes;     // size of the mesh files read
+    long long cacheHits;     // meshes restored from their MeshCache
+    long long cacheMisses;   // meshes whose cache was missing or stale
+    long long cameraSamples; // camera rays shot for the image
+    long long fixedSamples;  // the same without adaptive sampling
+
+    TraceStats() :
+        rays(0),
+        shadowRays(0),
+        nodeVisits(0),
+        triangleTests(0),
+        buildSeconds(0),
+        accelBytes(0),
+        meshBytes(0),
+        loadSeconds(0),
+        loadBytes(0),
+        cacheHits(0),
+        cacheMisses(0),
+        cameraSamples(0),
+        fixedSamples(0)
+    {
+    }
+};
+
+namespace Stats
+{
+    // Counter block of the calling thread.
+    TraceStats &local();
+
+    // Sum over all threads that have counted so far.
+    TraceStats total();
+
+    // Peak resident memory of the process in bytes, 0 where unknown.
+    long long peakMemory();
+
+    // Prints the totals plus per-ray averages and throughput.
+    void report(std::ostream &os, double seconds);
+}
+
+#endif // STATS_H
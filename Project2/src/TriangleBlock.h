@@ -0,0 +1,131 @@
+#ifndef TRIANGLE_BLOCK_H
+#define TRIANGLE_BLOCK_H
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Simd.h"
+#include "Vector3f.h"
+
+#include <cstdint>
+
+// Triangle::intersect's Cramer's rule on vectors: one ray against
+// SIMD_WIDTH triangles, or one triangle against SIMD_WIDTH rays. Triangles
+// are given as vertex a and the edges b - a and c - a. Returns the lanes
+// hit with tmin < t < tmax.
+inline vbool intersectTriangles(const vec3v &a, const vec3v &ba, const vec3v &ca,
+                                const vec3v &origin, const vec3v &direction,
+                                vfloat tmin, vfloat tmax,
+                                vfloat &t, vfloat &beta, vfloat &gamma)
+{
+    vec3v pvec = vcross(direction, ca);
+    vfloat dno = vdot(pvec, ba);
+    vec3v oa = origin - a;
+    vec3v num = vcross(oa, ba);
+
+    t = vdot(num, ca) / dno;
+    beta = vdot(pvec, oa) / dno;
+    gamma = vdot(num, direction) / dno;
+    return (beta > 0.0f) & (gamma > 0.0f) & (1.0f - beta - gamma > 0.0f) &
+           (t > tmin) & (t < tmax);
+}
+
+// SIMD_WIDTH triangles in structure-of-arrays form, the unit accelerator
+// leaves store their triangles in. Each lane holds vertex a and the edges
+// b - a and c - a, which is all the intersection test reads; lanes past
+// the end of a leaf are degenerate and never report a hit.
+struct alignas(32) TriangleBlock
+{
+    float ax[SIMD_WIDTH], ay[SIMD_WIDTH], az[SIMD_WIDTH];
+    float bax[SIMD_WIDTH], bay[SIMD_WIDTH], baz[SIMD_WIDTH];
+    float cax[SIMD_WIDTH], cay[SIMD_WIDTH], caz[SIMD_WIDTH];
+    int index[SIMD_WIDTH]; // triangle in the mesh, -1 for padding
+
+    TriangleBlock() {
+        for (int i = 0; i < SIMD_WIDTH; ++i) {
+            ax[i] = ay[i] = az[i] = 0;
+            bax[i] = bay[i] = baz[i] = 0;
+            cax[i] = cay[i] = caz[i] = 0;
+            index[i] = -1;
+        }
+    }
+
+    // blocks needed for a leaf of n triangles
+    static int blocksFor(int n) {
+        return (n + SIMD_WIDTH - 1) / SIMD_WIDTH;
+    }
+
+    void set(int lane, const Vector3f &a, const Vector3f &b, const Vector3f &c, int idx) {
+        Vector3f ba = b - a, ca = c - a;
+        ax[lane] = a[0]; ay[lane] = a[1]; az[lane] = a[2];
+        bax[lane] = ba[0]; bay[lane] = ba[1]; baz[lane] = ba[2];
+        cax[lane] = ca[0]; cay[lane] = ca[1]; caz[lane] = ca[2];
+        index[lane] = idx;
+    }
+
+    // Fills the block with triangles trigs[0, n), n <= SIMD_WIDTH, of an
+    // indexed mesh (three vertex indices per triangle). The remaining lanes
+    // become padding.
+    void gather(const Vector3f *vertices, const uint32_t *indices, const int *trigs, int n) {
+        for (int lane = 0; lane < SIMD_WIDTH; ++lane) {
+            if (lane < n) {
+                const uint32_t *v = indices + 3 * trigs[lane];
+                set(lane, vertices[v[0]], vertices[v[1]], vertices[v[2]], trigs[lane]);
+            } else {
+                ax[lane] = ay[lane] = az[lane] = 0;
+                bax[lane] = bay[lane] = baz[lane] = 0;
+                cax[lane] = cay[lane] = caz[lane] = 0;
+                index[lane] = -1;
+            }
+        }
+    }
+
+    // Tests the ray against every lane with Triangle::intersect's
+    // arithmetic. Returns the mask of lanes hit with tmin < t < tmax and
+    // stores t and the barycentrics of all lanes.
+    int intersect(const Ray &r, float tmin, float tmax,
+                  float *t, float *beta, float *gamma) const {
+        vec3v a = { vfloat::load(ax), vfloat::load(ay), vfloat::load(az) };
+        vec3v ba = { vfloat::load(bax), vfloat::load(bay), vfloat::load(baz) };
+        vec3v ca = { vfloat::load(cax), vfloat::load(cay), vfloat::load(caz) };
+
+        vfloat vt, vbeta, vgamma;
+        vbool hit = intersectTriangles(a, ba, ca, splat(r.getOrigin()), splat(r.getDirection()),
+                                       tmin, tmax, vt, vbeta, vgamma);
+        vt.store(t);
+        vbeta.store(beta);
+        vgamma.store(gamma);
+        return movemask(hit);
+    }
+
+    // Tests triangle `lane` against packet lanes [c, c + SIMD_WIDTH) with
+    // their closest hits so far in tmax.
+    int intersect(int lane, const RayPacket &p, int c, vfloat tmax,
+                  float *t, float *beta, float *gamma) const {
+        vec3v a = { ax[lane], ay[lane], az[lane] };
+        vec3v ba = { bax[lane], bay[lane], baz[lane] };
+        vec3v ca = { cax[lane], cay[lane], caz[lane] };
+
+        vfloat vt, vbeta, vgamma;
+        vbool hit = intersectTriangles(a, ba, ca, p.origin(c), p.direction(c),
+                                       vfloat::load(p.tmin + c), tmax, vt, vbeta, vgamma);
+        vt.store(t);
+        vbeta.store(beta);
+        vgamma.store(gamma);
+        return movemask(hit);
+    }
+
+    // Lane of the closest hit in mask, the lowest lane on ties, so the
+    // answer matches testing the triangles one by one in lane order.
+    static int closest(int mask, const float *t) {
+        int best = -1;
+        for (; mask; mask &= mask - 1) {
+            int i = RayPacket::ctz(mask);
+            if (best < 0 || t[i] < t[best]) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+#endif // TRIANGLE_BLOCK_H
@@ -90,10 +90,29 @@ int main(int argc, const char *argv[])
             << "\t-input <scene>\n"
             << "\t-size <width> <height>\n"
             << "\t-output <image.png>\n"
+            << "\t[-format <png|pfm|exr>]\n"
             << "\t[-depth <depth_min> <depth_max> <depth_image.png>\n]"
             << "\t[-normals <normals_image.png>]\n"
             << "\t[-bounces <max_bounces>\n]"
             << "\t[-shadows\n]"
+            << "\t[-env_lod <lod>]\n"
+            << "\t[-jitter]\n"
+            << "\t[-filter]\n"
+            << "\t[-samples <count>]\n"
+            << "\t[-sampler <independent|stratified|halton|sobol>]\n"
+            << "\t[-pixel_filter <box|tent|gaussian|mitchell>]\n"
+            << "\t[-filter_radius <pixels>]\n"
+            << "\t[-adaptive <max_samples> <threshold>]\n"
+            << "\t[-progressive]\n"
+            << "\t[-time_budget <seconds>]\n"
+            << "\t[-checkpoint <seconds>]\n"
+            << "\t[-stream]\n"
+            << "\t[-half_film]\n"
+            << "\t[-threads <count>]\n"
+            << "\t[-packet <0|4|8|16>]\n"
+            << "\t[-accel <none|octree|bvh>]\n"
+            << "\t[-no_mesh_cache]\n"
+            << "\t[-stats]\n"
             << "\n";
         return 1;
     }
@@ -9,31 +9,6 @@
 #include "Quat4f.h"
 #include "Vector3f.h"
 
-Matrix3f::Matrix3f( float fill )
-{
-	for( int i = 0; i < 9; ++i )
-	{
-		m_elements[ i ] = fill;
-	}
-}
-
-Matrix3f::Matrix3f( float m00, float m01, float m02,
-				   float m10, float m11, float m12,
-				   float m20, float m21, float m22 )
-{
-	m_elements[ 0 ] = m00;
-	m_elements[ 1 ] = m10;
-	m_elements[ 2 ] = m20;
-
-	m_elements[ 3 ] = m01;
-	m_elements[ 4 ] = m11;
-	m_elements[ 5 ] = m21;
-
-	m_elements[ 6 ] = m02;
-	m_elements[ 7 ] = m12;
-	m_elements[ 8 ] = m22;
-}
-
 Matrix3f::Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns )
 {
 	if( setColumns )
@@ -50,68 +25,6 @@ Matrix3f::Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
 	}
 }
 
-Matrix3f::Matrix3f( const Matrix3f& rm )
-{
-	memcpy( m_elements, rm.m_elements, sizeof(m_elements)  );
-}
-
-Matrix3f& Matrix3f::operator = ( const Matrix3f& rm )
-{
-	if( this != &rm )
-	{
-		memcpy( m_elements, rm.m_elements, sizeof(m_elements)  );
-	}
-	return *this;
-}
-
-const float& Matrix3f::operator () ( int i, int j ) const
-{
-	return m_elements[ j * 3 + i ];
-}
-
-float& Matrix3f::operator () ( int i, int j )
-{
-	return m_elements[ j * 3 + i ];
-}
-
-Vector3f Matrix3f::getRow( int i ) const
-{
-	return Vector3f
-	(
-		m_elements[ i ],
-		m_elements[ i + 3 ],
-		m_elements[ i + 6 ]
-	);
-}
-
-void Matrix3f::setRow( int i, const Vector3f& v )
-{
-	m_elements[ i ] = v.x();
-	m_elements[ i + 3 ] = v.y();
-	m_elements[ i + 6 ] = v.z();
-}
-
-Vector3f Matrix3f::getCol( int j ) const
-{
-	int colStart = 3 * j;
-
-	return Vector3f
-	(
-		m_elements[ colStart ],
-		m_elements[ colStart + 1 ],
-		m_elements[ colStart + 2 ]			
-	);
-}
-
-void Matrix3f::setCol( int j, const Vector3f& v )
-{
-	int colStart = 3 * j;
-
-	m_elements[ colStart ] = v.x();
-	m_elements[ colStart + 1 ] = v.y();
-	m_elements[ colStart + 2 ] = v.z();
-}
-
 Matrix2f Matrix3f::getSubmatrix2x2( int i0, int j0 ) const
 {
 	Matrix2f out;
@@ -218,25 +131,6 @@ void Matrix3f::transpose()
 	}
 }
 
-Matrix3f Matrix3f::transposed() const
-{
-	Matrix3f out;
-	for( int i = 0; i < 3; ++i )
-	{
-		for( int j = 0; j < 3; ++j )
-		{
-			out( j, i ) = ( *this )( i, j );
-		}
-	}
-
-	return out;
-}
-
-Matrix3f::operator float* ()
-{
-	return m_elements;
-}
-
 void Matrix3f::print()
 {
 	printf( "[ %.4f %.4f %.4f ]\n[ %.4f %.4f %.4f ]\n[ %.4f %.4f %.4f ]\n",
@@ -392,64 +286,3 @@ Matrix3f Matrix3f::rotation( const Quat4f& rq )
 			2.0f * ( xz - yw ),				2.0f * ( yz + xw ),				1.0f - 2.0f * ( xx + yy )
 		);
 }
-
-//////////////////////////////////////////////////////////////////////////
-// Operators
-//////////////////////////////////////////////////////////////////////////
-
-Vector3f operator * ( const Matrix3f& m, const Vector3f& v )
-{
-	Vector3f output( 0, 0, 0 );
-
-	for( int i = 0; i < 3; ++i )
-	{
-		for( int j = 0; j < 3; ++j )
-		{
-			output[ i ] += m( i, j ) * v[ j ];
-		}
-	}
-
-	return output;
-}
-
-Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y )
-{
-	Matrix3f product; // zeroes
-
-	for( int i = 0; i < 3; ++i )
-	{
-		for( int j = 0; j < 3; ++j )
-		{
-			for( int k = 0; k < 3; ++k )
-			{
-				product( i, k ) += x( i, j ) * y( j, k );
-			}
-		}
-	}
-
-	return product;
-}
-// Scalar multiplication 
-Matrix3f operator * (const Matrix3f& m, float f) {
-    Matrix3f product(m); // zeroes
-
-    for (int i = 0; i < 3; ++i)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            product(i, j) *= f;
-        }
-    }
-    return product;
-}
-Matrix3f operator * (float f, const Matrix3f& m) {
-    Matrix3f product(m); // zeroes
-    for (int i = 0; i < 3; ++i)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            product(i, j) *= f;
-        }
-    }
-    return product;
-}
@@ -3,9 +3,10 @@
 
 #include <cstdio>
 
+#include "Vector3f.h"
+
 class Matrix2f;
 class Quat4f;
-class Vector3f;
 
 // 3x3 Matrix, stored in column major order (OpenGL style)
 class Matrix3f
@@ -22,8 +23,8 @@ public:
 	// otherwise, sets the rows
 	Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns = true );
 
-	Matrix3f( const Matrix3f& rm ); // copy constructor
-	Matrix3f& operator = ( const Matrix3f& rm ); // assignment operator
+	Matrix3f( const Matrix3f& rm ) = default; // copy constructor
+	Matrix3f& operator = ( const Matrix3f& rm ) = default; // assignment operator
 	// no destructor necessary
 
 	const float& operator () ( int i, int j ) const;
@@ -77,16 +78,159 @@ private:
 
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline Matrix3f::Matrix3f( float fill )
+{
+	for( int i = 0; i < 9; ++i )
+	{
+		m_elements[ i ] = fill;
+	}
+}
+
+inline Matrix3f::Matrix3f( float m00, float m01, float m02,
+				   float m10, float m11, float m12,
+				   float m20, float m21, float m22 )
+{
+	m_elements[ 0 ] = m00;
+	m_elements[ 1 ] = m10;
+	m_elements[ 2 ] = m20;
+
+	m_elements[ 3 ] = m01;
+	m_elements[ 4 ] = m11;
+	m_elements[ 5 ] = m21;
+
+	m_elements[ 6 ] = m02;
+	m_elements[ 7 ] = m12;
+	m_elements[ 8 ] = m22;
+}
+
+inline const float& Matrix3f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline float& Matrix3f::operator () ( int i, int j )
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline Vector3f Matrix3f::getRow( int i ) const
+{
+	return Vector3f
+	(
+		m_elements[ i ],
+		m_elements[ i + 3 ],
+		m_elements[ i + 6 ]
+	);
+}
+
+inline void Matrix3f::setRow( int i, const Vector3f& v )
+{
+	m_elements[ i ] = v.x();
+	m_elements[ i + 3 ] = v.y();
+	m_elements[ i + 6 ] = v.z();
+}
+
+inline Vector3f Matrix3f::getCol( int j ) const
+{
+	int colStart = 3 * j;
+
+	return Vector3f
+	(
+		m_elements[ colStart ],
+		m_elements[ colStart + 1 ],
+		m_elements[ colStart + 2 ]
+	);
+}
+
+inline void Matrix3f::setCol( int j, const Vector3f& v )
+{
+	int colStart = 3 * j;
+
+	m_elements[ colStart ] = v.x();
+	m_elements[ colStart + 1 ] = v.y();
+	m_elements[ colStart + 2 ] = v.z();
+}
+
+inline Matrix3f Matrix3f::transposed() const
+{
+	Matrix3f out;
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			out( j, i ) = ( *this )( i, j );
+		}
+	}
+
+	return out;
+}
+
+inline Matrix3f::operator float* ()
+{
+	return m_elements;
+}
+
 // Matrix-Vector multiplication
 // 3x3 * 3x1 ==> 3x1
-Vector3f operator * ( const Matrix3f& m, const Vector3f& v );
+inline Vector3f operator * ( const Matrix3f& m, const Vector3f& v )
+{
+	Vector3f output( 0, 0, 0 );
 
-// Matrix-Matrix multiplication
-Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y );
+	for( int j = 0; j < 3; ++j )
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			output[ i ] += m( i, j ) * v[ j ];
+		}
+	}
 
-// Scalar multiplication 
-Matrix3f operator * (const Matrix3f& m, float f);
-Matrix3f operator * (float f, const Matrix3f& m);
+	return output;
+}
+
+// Matrix-Matrix multiplication
+inline Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y )
+{
+	Matrix3f product; // zeroes
+
+	// column by column, so the innermost loop runs down a column; each
+	// element still sums its terms in order of j
+	for( int k = 0; k < 3; ++k )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			for( int i = 0; i < 3; ++i )
+			{
+				product( i, k ) += x( i, j ) * y( j, k );
+			}
+		}
+	}
+
+	return product;
+}
+
+// Scalar multiplication
+inline Matrix3f operator * ( const Matrix3f& m, float f )
+{
+	Matrix3f product( m );
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			product( i, j ) *= f;
+		}
+	}
+	return product;
+}
+
+inline Matrix3f operator * ( float f, const Matrix3f& m )
+{
+	return m * f;
+}
 
 
 #endif // MATRIX3F_H
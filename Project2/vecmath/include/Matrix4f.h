@@ -3,11 +3,13 @@
 
 #include <cstdio>
 
+#include "vecmath_simd.h"
+#include "Vector3f.h"
+#include "Vector4f.h"
+
 class Matrix2f;
 class Matrix3f;
 class Quat4f;
-class Vector3f;
-class Vector4f;
 
 // 4x4 Matrix, stored in column major order (OpenGL style)
 class Matrix4f
@@ -24,8 +26,8 @@ public:
     // otherwise, sets the rows
     Matrix4f(const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns = true);
 
-    Matrix4f(const Matrix4f& rm); // copy constructor
-    Matrix4f& operator = (const Matrix4f& rm); // assignment operator
+    Matrix4f(const Matrix4f& rm) = default; // copy constructor
+    Matrix4f& operator = (const Matrix4f& rm) = default; // assignment operator
     Matrix4f& operator/=(float d);
     // no destructor necessary
 
@@ -94,20 +96,208 @@ public:
 
 private:
 
+#ifdef VECMATH_SIMD_STORAGE
+    alignas(16) float m_elements[16];
+#else
     float m_elements[16];
+#endif
 
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline Matrix4f::Matrix4f( float fill )
+{
+	for( int i = 0; i < 16; ++i )
+	{
+		m_elements[ i ] = fill;
+	}
+}
+
+inline Matrix4f::Matrix4f( float m00, float m01, float m02, float m03,
+				   float m10, float m11, float m12, float m13,
+				   float m20, float m21, float m22, float m23,
+				   float m30, float m31, float m32, float m33 )
+{
+	m_elements[ 0 ] = m00;
+	m_elements[ 1 ] = m10;
+	m_elements[ 2 ] = m20;
+	m_elements[ 3 ] = m30;
+
+	m_elements[ 4 ] = m01;
+	m_elements[ 5 ] = m11;
+	m_elements[ 6 ] = m21;
+	m_elements[ 7 ] = m31;
+
+	m_elements[ 8 ] = m02;
+	m_elements[ 9 ] = m12;
+	m_elements[ 10 ] = m22;
+	m_elements[ 11 ] = m32;
+
+	m_elements[ 12 ] = m03;
+	m_elements[ 13 ] = m13;
+	m_elements[ 14 ] = m23;
+	m_elements[ 15 ] = m33;
+}
+
+inline const float& Matrix4f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 4 + i ];
+}
+
+inline float& Matrix4f::operator () ( int i, int j )
+{
+	return m_elements[ j * 4 + i ];
+}
+
+inline Vector4f Matrix4f::getRow( int i ) const
+{
+	return Vector4f
+	(
+		m_elements[ i ],
+		m_elements[ i + 4 ],
+		m_elements[ i + 8 ],
+		m_elements[ i + 12 ]
+	);
+}
+
+inline void Matrix4f::setRow( int i, const Vector4f& v )
+{
+	m_elements[ i ] = v.x();
+	m_elements[ i + 4 ] = v.y();
+	m_elements[ i + 8 ] = v.z();
+	m_elements[ i + 12 ] = v.w();
+}
+
+inline Vector4f Matrix4f::getCol( int j ) const
+{
+	int colStart = 4 * j;
+
+	return Vector4f
+	(
+		m_elements[ colStart ],
+		m_elements[ colStart + 1 ],
+		m_elements[ colStart + 2 ],
+		m_elements[ colStart + 3 ]
+	);
+}
+
+inline void Matrix4f::setCol( int j, const Vector4f& v )
+{
+	int colStart = 4 * j;
+
+	m_elements[ colStart ] = v.x();
+	m_elements[ colStart + 1 ] = v.y();
+	m_elements[ colStart + 2 ] = v.z();
+	m_elements[ colStart + 3 ] = v.w();
+}
+
+inline Matrix4f Matrix4f::transposed() const
+{
+	Matrix4f out;
+	for( int i = 0; i < 4; ++i )
+	{
+		for( int j = 0; j < 4; ++j )
+		{
+			out( j, i ) = ( *this )( i, j );
+		}
+	}
+
+	return out;
+}
+
+inline Matrix4f::operator float* ()
+{
+	return m_elements;
+}
+
+inline Matrix4f::operator const float* () const
+{
+	return m_elements;
+}
+
 // Matrix-Vector multiplication
 // 4x4 * 4x1 ==> 4x1
-Vector4f operator * (const Matrix4f& m, const Vector4f& v);
+inline Vector4f operator * ( const Matrix4f& m, const Vector4f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	// columns scaled by the coordinates, summed in the same order as below
+	vecmath::float4 output = vecmath::splat4( 0 );
+	for( int j = 0; j < 4; ++j )
+	{
+		output = vecmath::add4( output, vecmath::mul4( vecmath::load4( &m( 0, j ) ), vecmath::splat4( v[ j ] ) ) );
+	}
+
+	return Vector4f( output );
+#else
+	Vector4f output( 0, 0, 0, 0 );
+
+	for( int j = 0; j < 4; ++j )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			output[ i ] += m( i, j ) * v[ j ];
+		}
+	}
+
+	return output;
+#endif
+}
 
 // Matrix-Matrix multiplication
-Matrix4f operator * (const Matrix4f& x, const Matrix4f& y);
+inline Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y )
+{
+	Matrix4f product; // zeroes
+
+#ifdef VECMATH_SIMD_STORAGE
+	for( int k = 0; k < 4; ++k )
+	{
+		vecmath::float4 column = vecmath::load4( &product( 0, k ) );
+		for( int j = 0; j < 4; ++j )
+		{
+			column = vecmath::add4( column, vecmath::mul4( vecmath::load4( &x( 0, j ) ), vecmath::splat4( y( j, k ) ) ) );
+		}
+		vecmath::store4( &product( 0, k ), column );
+	}
+#else
+	// column by column, so the innermost loop runs down a column; each
+	// element still sums its terms in order of j
+	for( int k = 0; k < 4; ++k )
+	{
+		for( int j = 0; j < 4; ++j )
+		{
+			for( int i = 0; i < 4; ++i )
+			{
+				product( i, k ) += x( i, j ) * y( j, k );
+			}
+		}
+	}
+#endif
 
-// Scalar multiplication 
-Matrix4f operator * (const Matrix4f& m, float f);
-Matrix4f operator * (float f, const Matrix4f& m);
+	return product;
+}
+
+// Scalar multiplication
+inline Matrix4f operator * ( const Matrix4f& m, float f )
+{
+	Matrix4f product( m );
+
+	for( int i = 0; i < 4; ++i )
+	{
+		for( int j = 0; j < 4; ++j )
+		{
+			product( i, j ) *= f;
+		}
+	}
+	return product;
+}
+
+inline Matrix4f operator * ( float f, const Matrix4f& m )
+{
+	return m * f;
+}
 
 
 #endif // MATRIX4F_H
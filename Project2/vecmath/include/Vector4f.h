@@ -1,35 +1,38 @@
 #ifndef VECTOR_4F_H
 #define VECTOR_4F_H
 
-class Vector2f;
-class Vector3f;
+#include <cmath>
+
+#include "vecmath_simd.h"
+#include "Vector2f.h"
+#include "Vector3f.h"
 
 class Vector4f
 {
 public:
 
-	explicit Vector4f( float f = 0.f );
-	Vector4f( float fx, float fy, float fz, float fw );
+	explicit constexpr Vector4f( float f = 0.f );
+	constexpr Vector4f( float fx, float fy, float fz, float fw );
 	Vector4f( float buffer[ 4 ] );
 
-	Vector4f( const Vector2f& xy, float z, float w );
-	Vector4f( float x, const Vector2f& yz, float w );
-	Vector4f( float x, float y, const Vector2f& zw );
-	Vector4f( const Vector2f& xy, const Vector2f& zw );
+	constexpr Vector4f( const Vector2f& xy, float z, float w );
+	constexpr Vector4f( float x, const Vector2f& yz, float w );
+	constexpr Vector4f( float x, float y, const Vector2f& zw );
+	constexpr Vector4f( const Vector2f& xy, const Vector2f& zw );
 
-	Vector4f( const Vector3f& xyz, float w );
-	Vector4f( float x, const Vector3f& yzw );
+	constexpr Vector4f( const Vector3f& xyz, float w );
+	constexpr Vector4f( float x, const Vector3f& yzw );
 
 	// copy constructors
-	Vector4f( const Vector4f& rv );
+	Vector4f( const Vector4f& rv ) = default;
 
 	// assignment operators
-	Vector4f& operator = ( const Vector4f& rv );
+	Vector4f& operator = ( const Vector4f& rv ) = default;
 
 	// no destructor necessary
 
 	// returns the ith element
-	const float& operator [] ( int i ) const;
+	constexpr const float& operator [] ( int i ) const;
 	float& operator [] ( int i );
 
 	float& x();
@@ -37,28 +40,28 @@ public:
 	float& z();
 	float& w();
 
-	float x() const;
-	float y() const;
-	float z() const;
-	float w() const;
+	constexpr float x() const;
+	constexpr float y() const;
+	constexpr float z() const;
+	constexpr float w() const;
 
-	Vector2f xy() const;
-	Vector2f yz() const;
-	Vector2f zw() const;
-	Vector2f wx() const;
+	constexpr Vector2f xy() const;
+	constexpr Vector2f yz() const;
+	constexpr Vector2f zw() const;
+	constexpr Vector2f wx() const;
 
-	Vector3f xyz() const;
-	Vector3f yzw() const;
-	Vector3f zwx() const;
-	Vector3f wxy() const;
+	constexpr Vector3f xyz() const;
+	constexpr Vector3f yzw() const;
+	constexpr Vector3f zwx() const;
+	constexpr Vector3f wxy() const;
 
-	Vector3f xyw() const;
-	Vector3f yzx() const;
-	Vector3f zwy() const;
-	Vector3f wxz() const;
+	constexpr Vector3f xyw() const;
+	constexpr Vector3f yzx() const;
+	constexpr Vector3f zwy() const;
+	constexpr Vector3f wxz() const;
 
 	float abs() const;
-	float absSquared() const;
+	constexpr float absSquared() const;
 	void normalize();
 	Vector4f normalized() const;
 
@@ -71,32 +74,371 @@ public:
 	// ---- Utility ----
 	operator const float* () const; // automatic type conversion for OpenGL
 	operator float* (); // automatic type conversion for OpenG
-	void print() const; 
+	void print() const;
+
+	static constexpr float dot( const Vector4f& v0, const Vector4f& v1 );
+	static VECMATH_CONSTEXPR Vector4f lerp( const Vector4f& v0, const Vector4f& v1, float alpha );
 
-	static float dot( const Vector4f& v0, const Vector4f& v1 );
-	static Vector4f lerp( const Vector4f& v0, const Vector4f& v1, float alpha );
+#ifdef VECMATH_SIMD_STORAGE
+	// the register form
+	explicit Vector4f( vecmath::float4 v );
+	vecmath::float4 simd() const;
+#endif
 
 private:
 
+#ifdef VECMATH_SIMD_STORAGE
+	alignas( 16 ) float m_elements[ 4 ];
+#else
 	float m_elements[ 4 ];
+#endif
 
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+inline constexpr Vector4f::Vector4f( float f ) :
+	m_elements{ f, f, f, f }
+{
+}
+
+inline constexpr Vector4f::Vector4f( float fx, float fy, float fz, float fw ) :
+	m_elements{ fx, fy, fz, fw }
+{
+}
+
+inline Vector4f::Vector4f( float buffer[ 4 ] ) :
+	m_elements{ buffer[ 0 ], buffer[ 1 ], buffer[ 2 ], buffer[ 3 ] }
+{
+}
+
+inline constexpr Vector4f::Vector4f( const Vector2f& xy, float z, float w ) :
+	m_elements{ xy.x(), xy.y(), z, w }
+{
+}
+
+inline constexpr Vector4f::Vector4f( float x, const Vector2f& yz, float w ) :
+	m_elements{ x, yz.x(), yz.y(), w }
+{
+}
+
+inline constexpr Vector4f::Vector4f( float x, float y, const Vector2f& zw ) :
+	m_elements{ x, y, zw.x(), zw.y() }
+{
+}
+
+inline constexpr Vector4f::Vector4f( const Vector2f& xy, const Vector2f& zw ) :
+	m_elements{ xy.x(), xy.y(), zw.x(), zw.y() }
+{
+}
+
+inline constexpr Vector4f::Vector4f( const Vector3f& xyz, float w ) :
+	m_elements{ xyz.x(), xyz.y(), xyz.z(), w }
+{
+}
+
+inline constexpr Vector4f::Vector4f( float x, const Vector3f& yzw ) :
+	m_elements{ x, yzw.x(), yzw.y(), yzw.z() }
+{
+}
+
+#ifdef VECMATH_SIMD_STORAGE
+inline Vector4f::Vector4f( vecmath::float4 v )
+{
+	vecmath::store4( m_elements, v );
+}
+
+inline vecmath::float4 Vector4f::simd() const
+{
+	return vecmath::load4( m_elements );
+}
+#endif
+
+inline constexpr const float& Vector4f::operator [] ( int i ) const
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector4f::operator [] ( int i )
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector4f::x()
+{
+	return m_elements[ 0 ];
+}
+
+inline float& Vector4f::y()
+{
+	return m_elements[ 1 ];
+}
+
+inline float& Vector4f::z()
+{
+	return m_elements[ 2 ];
+}
+
+inline float& Vector4f::w()
+{
+	return m_elements[ 3 ];
+}
+
+inline constexpr float Vector4f::x() const
+{
+	return m_elements[ 0 ];
+}
+
+inline constexpr float Vector4f::y() const
+{
+	return m_elements[ 1 ];
+}
+
+inline constexpr float Vector4f::z() const
+{
+	return m_elements[ 2 ];
+}
+
+inline constexpr float Vector4f::w() const
+{
+	return m_elements[ 3 ];
+}
+
+inline constexpr Vector2f Vector4f::xy() const
+{
+	return Vector2f( m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline constexpr Vector2f Vector4f::yz() const
+{
+	return Vector2f( m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+inline constexpr Vector2f Vector4f::zw() const
+{
+	return Vector2f( m_elements[ 2 ], m_elements[ 3 ] );
+}
+
+inline constexpr Vector2f Vector4f::wx() const
+{
+	return Vector2f( m_elements[ 3 ], m_elements[ 0 ] );
+}
+
+inline constexpr Vector3f Vector4f::xyz() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+inline constexpr Vector3f Vector4f::yzw() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 3 ] );
+}
+
+inline constexpr Vector3f Vector4f::zwx() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 3 ], m_elements[ 0 ] );
+}
+
+inline constexpr Vector3f Vector4f::wxy() const
+{
+	return Vector3f( m_elements[ 3 ], m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline constexpr Vector3f Vector4f::xyw() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 3 ] );
+}
+
+inline constexpr Vector3f Vector4f::yzx() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] );
+}
+
+inline constexpr Vector3f Vector4f::zwy() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 3 ], m_elements[ 1 ] );
+}
+
+inline constexpr Vector3f Vector4f::wxz() const
+{
+	return Vector3f( m_elements[ 3 ], m_elements[ 0 ], m_elements[ 2 ] );
+}
+
+inline float Vector4f::abs() const
+{
+	return std::sqrt( absSquared() );
+}
+
+inline constexpr float Vector4f::absSquared() const
+{
+	return m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ] + m_elements[ 3 ] * m_elements[ 3 ];
+}
+
+inline void Vector4f::normalize()
+{
+	float norm = abs();
+	m_elements[ 0 ] = m_elements[ 0 ] / norm;
+	m_elements[ 1 ] = m_elements[ 1 ] / norm;
+	m_elements[ 2 ] = m_elements[ 2 ] / norm;
+	m_elements[ 3 ] = m_elements[ 3 ] / norm;
+}
+
+inline Vector4f Vector4f::normalized() const
+{
+	float length = abs();
+	return Vector4f
+		(
+			m_elements[ 0 ] / length,
+			m_elements[ 1 ] / length,
+			m_elements[ 2 ] / length,
+			m_elements[ 3 ] / length
+		);
+}
+
+inline void Vector4f::homogenize()
+{
+	if( m_elements[ 3 ] != 0 )
+	{
+		m_elements[ 0 ] /= m_elements[ 3 ];
+		m_elements[ 1 ] /= m_elements[ 3 ];
+		m_elements[ 2 ] /= m_elements[ 3 ];
+		m_elements[ 3 ] = 1;
+	}
+}
+
+inline Vector4f Vector4f::homogenized() const
+{
+	if( m_elements[ 3 ] != 0 )
+	{
+		return Vector4f
+			(
+				m_elements[ 0 ] / m_elements[ 3 ],
+				m_elements[ 1 ] / m_elements[ 3 ],
+				m_elements[ 2 ] / m_elements[ 3 ],
+				1
+			);
+	}
+	else
+	{
+		return *this;
+	}
+}
+
+inline void Vector4f::negate()
+{
+	m_elements[ 0 ] = -m_elements[ 0 ];
+	m_elements[ 1 ] = -m_elements[ 1 ];
+	m_elements[ 2 ] = -m_elements[ 2 ];
+	m_elements[ 3 ] = -m_elements[ 3 ];
+}
+
+inline Vector4f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline Vector4f::operator float* ()
+{
+	return m_elements;
+}
+
+// static
+inline constexpr float Vector4f::dot( const Vector4f& v0, const Vector4f& v1 )
+{
+	return v0.x() * v1.x() + v0.y() * v1.y() + v0.z() * v1.z() + v0.w() * v1.w();
+}
+
 // component-wise operators
-Vector4f operator + ( const Vector4f& v0, const Vector4f& v1 );
-Vector4f operator - ( const Vector4f& v0, const Vector4f& v1 );
-Vector4f operator * ( const Vector4f& v0, const Vector4f& v1 );
-Vector4f operator / ( const Vector4f& v0, const Vector4f& v1 );
+inline VECMATH_CONSTEXPR Vector4f operator + ( const Vector4f& v0, const Vector4f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::add4( v0.simd(), v1.simd() ) );
+#else
+	return Vector4f( v0.x() + v1.x(), v0.y() + v1.y(), v0.z() + v1.z(), v0.w() + v1.w() );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector4f operator - ( const Vector4f& v0, const Vector4f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::sub4( v0.simd(), v1.simd() ) );
+#else
+	return Vector4f( v0.x() - v1.x(), v0.y() - v1.y(), v0.z() - v1.z(), v0.w() - v1.w() );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector4f operator * ( const Vector4f& v0, const Vector4f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::mul4( v0.simd(), v1.simd() ) );
+#else
+	return Vector4f( v0.x() * v1.x(), v0.y() * v1.y(), v0.z() * v1.z(), v0.w() * v1.w() );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector4f operator / ( const Vector4f& v0, const Vector4f& v1 )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::div4( v0.simd(), v1.simd() ) );
+#else
+	return Vector4f( v0.x() / v1.x(), v0.y() / v1.y(), v0.z() / v1.z(), v0.w() / v1.w() );
+#endif
+}
 
 // unary negation
-Vector4f operator - ( const Vector4f& v );
+inline VECMATH_CONSTEXPR Vector4f operator - ( const Vector4f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::neg4( v.simd() ) );
+#else
+	return Vector4f( -v.x(), -v.y(), -v.z(), -v.w() );
+#endif
+}
 
 // multiply and divide by scalar
-Vector4f operator * ( float f, const Vector4f& v );
-Vector4f operator * ( const Vector4f& v, float f );
-Vector4f operator / ( const Vector4f& v, float f );
+inline VECMATH_CONSTEXPR Vector4f operator * ( float f, const Vector4f& v )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::mul4( vecmath::splat4( f ), v.simd() ) );
+#else
+	return Vector4f( f * v.x(), f * v.y(), f * v.z(), f * v.w() );
+#endif
+}
 
-bool operator == ( const Vector4f& v0, const Vector4f& v1 );
-bool operator != ( const Vector4f& v0, const Vector4f& v1 );
+inline VECMATH_CONSTEXPR Vector4f operator * ( const Vector4f& v, float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::mul4( vecmath::splat4( f ), v.simd() ) );
+#else
+	return Vector4f( f * v.x(), f * v.y(), f * v.z(), f * v.w() );
+#endif
+}
+
+inline VECMATH_CONSTEXPR Vector4f operator / ( const Vector4f& v, float f )
+{
+#ifdef VECMATH_SIMD_STORAGE
+	return Vector4f( vecmath::div4( v.simd(), vecmath::splat4( f ) ) );
+#else
+	return Vector4f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f, v[ 3 ] / f );
+#endif
+}
+
+inline constexpr bool operator == ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() && v0.w() == v1.w() );
+}
+
+inline constexpr bool operator != ( const Vector4f& v0, const Vector4f& v1 )
+{
+	return !( v0 == v1 );
+}
+
+// static
+inline VECMATH_CONSTEXPR Vector4f Vector4f::lerp( const Vector4f& v0, const Vector4f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
 
 #endif // VECTOR_4F_H